@@ -0,0 +1,377 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""Benchmarks of the components, which dominate judging time: testlib's
+readers, the standard checkers and the run utility.
+
+Usage:
+    python setup.py benchmark [--scale 1000000] [--runs 3] [--filter reader/]
+                              [--output results.json] [--baseline old.json]
+
+Inputs are generated once into benchmarks/pygon-build, programs are
+compiled with pygon's own compile commands. Results are written as JSON:
+{"scale": ..., "compiler": ..., "results": {name: {"time": ..., ...}}},
+where time is the minimum wall time of the runs in seconds (per invocation
+for run/ benchmarks). Given a baseline, ratios to it are printed and
+the exit code is 1 if something became slower than the threshold allows.
+"""
+
+import os
+import sys
+import json
+import time
+import random
+import argparse
+import platform
+import statistics
+import subprocess
+
+from pkg_resources import resource_filename
+
+from pygon.config import BUILD_DIR
+from pygon.language import Language
+from pygon.invoke import (Invoke, Runner, ensure_run_built, get_run_path,
+                          get_run_options, get_limit_args)
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BUILD = os.path.join(HERE, BUILD_DIR)
+
+# Numbers are written in lines of this many values.
+CHUNK = 10 ** 5
+
+
+def gen_ints(rnd, n):
+    for i in range(0, n, CHUNK):
+        yield " ".join(str(rnd.randint(-10 ** 9, 10 ** 9))
+                       for _ in range(min(CHUNK, n - i)))
+
+
+def gen_doubles(rnd, n):
+    for i in range(0, n, CHUNK):
+        yield " ".join("%.9f" % rnd.uniform(-10 ** 4, 10 ** 4)
+                       for _ in range(min(CHUNK, n - i)))
+
+
+def gen_tokens(rnd, n):
+    # n characters in tokens of 1000 letters.
+    letters = "abcdefghijklmnopqrstuvwxyz"
+    for i in range(0, n, 1000):
+        yield "".join(rnd.choice(letters) for _ in range(min(1000, n - i)))
+
+
+def gen_lines(rnd, n):
+    # n characters in lines of 1..20 numbers separated by spaces.
+    size = 0
+    while size < n:
+        line = " ".join(str(rnd.randint(0, 10 ** 6))
+                        for _ in range(rnd.randint(1, 20)))
+        size += len(line) + 1
+        yield line
+
+
+def gen_huge(rnd, n):
+    yield str(rnd.randint(1, 9)) + "".join(str(rnd.randint(0, 9))
+                                           for _ in range(n - 1))
+
+
+# Input kinds: name -> generator of lines with n values (or characters).
+INPUTS = {
+    "ints": gen_ints,
+    "doubles": gen_doubles,
+    "tokens": gen_tokens,
+    "lines": gen_lines,
+    "huge": gen_huge,
+}
+
+# Reader benchmarks: name -> input kind (see readers.cpp).
+READERS = {
+    "int": "ints",
+    "long": "ints",
+    "longs-up-to": "ints",
+    "parse-long": "ints",
+    "double": "doubles",
+    "doubles-up-to": "doubles",
+    "parse-double": "doubles",
+    "token": "tokens",
+    "token-pattern": "tokens",
+    "line": "lines",
+    "char": "lines",
+    "well-formed": "lines",
+}
+
+# Checker benchmarks: standard checker -> input kind. Outputs are equal
+# to answers, so that checkers read everything.
+CHECKERS = {
+    "fcmp": "lines",
+    "lcmp": "lines",
+    "wcmp": "ints",
+    "ncmp": "ints",
+    "rcmp6": "doubles",
+    "rcmp9": "doubles",
+    "hcmp": "huge",
+}
+
+
+def get_input(kind, scale):
+    """Returns path to the input of kind for the scale, generating it
+    if it doesn't exist yet."""
+
+    path = os.path.join(BUILD, "inputs", "{}-{}.txt".format(kind, scale))
+
+    if not os.path.exists(path):
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        rnd = random.Random(kind)
+        with open(path + ".tmp", "w") as f:
+            for line in INPUTS[kind](rnd, scale):
+                f.write(line)
+                f.write("\n")
+        os.replace(path + ".tmp", path)
+
+    return path
+
+
+def compile_program(src, name):
+    """Compiles a C++ program with testlib.h, returns path to it."""
+
+    exe = os.path.join(BUILD, "bin", name)
+    os.makedirs(os.path.dirname(exe), exist_ok=True)
+
+    if not os.path.exists(exe) or \
+            os.path.getmtime(exe) < os.path.getmtime(src) or \
+            os.path.getmtime(exe) < os.path.getmtime(get_testlib()):
+        Language.from_name("c++11").compile(
+            src, exe, [os.path.dirname(get_testlib())])
+
+    return exe
+
+
+def get_testlib():
+    return resource_filename("pygon", os.path.join("data", "resources",
+                                                   "testlib.h"))
+
+
+def measure(cmd, runs, stdin=None):
+    """Runs a command several times.
+
+    Returns:
+        dict: time (minimum wall time), median (median wall time),
+        cpu (CPU time of the fastest run) in seconds, and memory
+        (peak RSS in MiB).
+    """
+
+    walls, cpus, memory = [], [], 0
+
+    for _ in range(runs):
+        with open(stdin or os.devnull, "rb") as inp:
+            start = time.perf_counter()
+            proc = subprocess.Popen(cmd, stdin=inp,
+                                    stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+            _, status, usage = os.wait4(proc.pid, 0)
+            walls.append(time.perf_counter() - start)
+
+        if os.WIFSIGNALED(status):
+            proc.returncode = -os.WTERMSIG(status)
+        else:
+            proc.returncode = os.WEXITSTATUS(status)
+        if proc.returncode != 0:
+            raise RuntimeError("{} failed with exit code {}".format(
+                " ".join(cmd), proc.returncode))
+
+        cpus.append(usage.ru_utime + usage.ru_stime)
+        memory = max(memory, usage.ru_maxrss / 1024)
+
+    fastest = walls.index(min(walls))
+
+    return dict(time=walls[fastest], median=statistics.median(walls),
+                cpu=cpus[fastest], memory=memory)
+
+
+def measure_calls(func, count, runs):
+    """Times count calls of func several times.
+
+    Returns:
+        dict: time (minimum) and median of wall time per call in seconds.
+    """
+
+    times = []
+
+    for _ in range(runs):
+        start = time.perf_counter()
+        for _ in range(count):
+            func()
+        times.append((time.perf_counter() - start) / count)
+
+    return dict(time=min(times), median=statistics.median(times))
+
+
+def bench_readers(args, results):
+    exe = None
+
+    for path, kind in READERS.items():
+        name = "reader/" + path
+        if args.filter not in name:
+            continue
+        if exe is None:
+            exe = compile_program(os.path.join(HERE, "readers.cpp"),
+                                  "readers")
+        inp = get_input(kind, args.scale)
+        res = measure([exe, path, inp], args.runs)
+        res["bytes"] = os.path.getsize(inp)
+        results[name] = res
+        report(name, res)
+
+
+def bench_checkers(args, results):
+    for checker, kind in CHECKERS.items():
+        name = "checker/" + checker
+        if args.filter not in name:
+            continue
+        src = resource_filename("pygon", os.path.join("data", "checkers",
+                                                      checker + ".cpp"))
+        exe = compile_program(src, checker)
+        inp = get_input(kind, args.scale)
+        res = measure([exe, inp, inp, inp], args.runs)
+        res["bytes"] = 2 * os.path.getsize(inp)
+        results[name] = res
+        report(name, res)
+
+
+def bench_run(args, results):
+    """Measures the cost of running a trivial command: spawning it directly,
+    with the run utility, and with the persistent one (Runner)."""
+
+    ensure_run_built()
+
+    count = max(args.scale // 10 ** 4, 10)
+    true = ["/bin/true"] if os.path.exists("/bin/true") else ["true"]
+
+    def spawn():
+        subprocess.run(true, stdin=subprocess.DEVNULL,
+                       stdout=subprocess.DEVNULL)
+
+    def run_utility():
+        subprocess.run([get_run_path()] + get_run_options() +
+                       get_limit_args(1.0, 256.0) + [os.devnull] + true,
+                       stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL)
+
+    def invoke():
+        with open(os.devnull, "rb") as inp, open(os.devnull, "wb") as out:
+            cmd = Invoke(true)
+            cmd.stdin, cmd.stdout = inp, out
+            cmd.run()
+
+    cases = [("run/spawn", spawn), ("run/utility", run_utility),
+             ("run/invoke", invoke)]
+
+    runner = Runner() if Runner.is_supported() else None
+
+    if runner:
+        cases.append(("run/runner", lambda: runner.run(
+            true, None, os.devnull, os.devnull, 1.0, 256.0)))
+
+    try:
+        for name, func in cases:
+            if args.filter not in name:
+                continue
+            res = measure_calls(func, count, args.runs)
+            results[name] = res
+            report(name, res)
+    finally:
+        if runner:
+            runner.close()
+
+
+def report(name, res):
+    s = "{:<24} {:>10.3f} ms".format(name, 1000 * res["time"])
+    if "bytes" in res:
+        s += " {:>8.1f} MB/s".format(res["bytes"] / res["time"] / 1e6)
+    print(s, flush=True)
+
+
+def compare(results, baseline, threshold):
+    """Prints ratios of times to the baseline's ones.
+
+    Returns:
+        list: names of benchmarks, which are slower than the baseline
+        by more than threshold (e.g. 0.1 means 10%).
+    """
+
+    slower = []
+
+    print()
+    print("{:<24} {:>10} {:>10} {:>7}".format("benchmark", "ms", "base ms",
+                                             "ratio"))
+
+    for name, res in results.items():
+        if name not in baseline:
+            continue
+        base = baseline[name]["time"]
+        ratio = res["time"] / base if base > 0 else 1.0
+        mark = ""
+        if ratio > 1 + threshold:
+            slower.append(name)
+            mark = " slower"
+        print("{:<24} {:>10.3f} {:>10.3f} {:>7.2f}{}".format(
+            name, 1000 * res["time"], 1000 * base, ratio, mark))
+
+    return slower
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--scale", type=int, default=10 ** 6,
+                        help="number of values (or characters) in inputs")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="number of runs of every benchmark")
+    parser.add_argument("--filter", default="",
+                        help="run only benchmarks with names containing it")
+    parser.add_argument("--output", help="file to write results to (JSON)")
+    parser.add_argument("--baseline", help="results to compare with (JSON)")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="allowed slowdown relative to the baseline")
+    args = parser.parse_args(argv)
+
+    results = {}
+    bench_readers(args, results)
+    bench_checkers(args, results)
+    bench_run(args, results)
+
+    data = dict(scale=args.scale, runs=args.runs,
+                compiler=Language.from_name("c++11").get_compiler_id(),
+                machine=platform.machine(), system=platform.system(),
+                results=results)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(data, f, indent=2, sort_keys=True)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["results"]
+        if compare(results, baseline, args.threshold):
+            return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,122 @@
+/*
+ * Benchmark of testlib's read paths. Reads the whole file with one of them
+ * (as the output of a checker, i.e. in the non-strict mode) and writes
+ * the number of read values and their checksum to stdout.
+ *
+ * Usage: readers <path> <file>
+ */
+
+#include "testlib.h"
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+/* Numbers are read in blocks of this size. */
+const size_t BLOCK_SIZE = 1 << 12;
+
+long long longBlock[BLOCK_SIZE];
+double doubleBlock[BLOCK_SIZE];
+
+unsigned long long valueCount = 0;
+unsigned long long checksum = 0;
+
+void add(unsigned long long value)
+{
+    valueCount++;
+    checksum = checksum * 1000003 + value;
+}
+
+void addDouble(double value)
+{
+    add((unsigned long long)(long long)(value * 1000));
+}
+
+void readLongs(bool blocks)
+{
+    while (!ouf.seekEof())
+    {
+        size_t k = blocks ? ouf.readLongsUpTo(longBlock, BLOCK_SIZE) : 0;
+        if (k == 0)
+            add(ouf.readLong());
+        for (size_t i = 0; i < k; i++)
+            add(longBlock[i]);
+    }
+}
+
+void readDoubles(bool blocks)
+{
+    while (!ouf.seekEof())
+    {
+        size_t k = blocks ? ouf.readDoublesUpTo(doubleBlock, BLOCK_SIZE) : 0;
+        if (k == 0)
+            addDouble(ouf.readDouble());
+        for (size_t i = 0; i < k; i++)
+            addDouble(doubleBlock[i]);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <path> <file>\n", argv[0]);
+        return 1;
+    }
+
+    string path = argv[1];
+    char* args[] = {argv[0], argv[2], argv[2], argv[2], NULL};
+    registerTestlibCmd(4, args);
+
+    string token;
+
+    if (path == "int")
+        while (!ouf.seekEof())
+            add(ouf.readInt());
+    else if (path == "long")
+        readLongs(false);
+    else if (path == "longs-up-to")
+        readLongs(true);
+    else if (path == "parse-long")
+        /* The generic path behind readLong, without the fast one. */
+        while (!ouf.seekEof())
+        {
+            ouf.readWordTo(token);
+            add(stringToLongLong(ouf, token.c_str()));
+        }
+    else if (path == "double")
+        readDoubles(false);
+    else if (path == "doubles-up-to")
+        readDoubles(true);
+    else if (path == "parse-double")
+        while (!ouf.seekEof())
+        {
+            ouf.readWordTo(token);
+            addDouble(stringToDouble(ouf, token.c_str()));
+        }
+    else if (path == "token")
+        while (!ouf.seekEof())
+        {
+            ouf.readWordTo(token);
+            add(token.size());
+        }
+    else if (path == "token-pattern")
+        while (!ouf.seekEof())
+            add(ouf.readToken("[a-z]{1,1000000}").size());
+    else if (path == "line")
+        while (!ouf.seekEof())
+            add(ouf.readLine().size());
+    else if (path == "char")
+        while (!ouf.eof())
+            add(ouf.readChar());
+    else if (path == "well-formed")
+    {
+        ouf.validateWellFormed();
+        add(0);
+    }
+    else
+        quitf(_fail, "unknown path %s", path.c_str());
+
+    printf("%llu %llu\n", valueCount, checksum);
+    quitf(_ok, "%llu values", valueCount);
+}
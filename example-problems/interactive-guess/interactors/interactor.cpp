@@ -11,8 +11,8 @@ void upd(int& lf, int& rg, int x, int y) {
 }
 
 void send(string x) {
-	cout << x << endl;
-   	fflush(stdout);
+	bout << x << '\n';
+	bout.flush();
 }
 
 const int INF = 1000000000;
@@ -22,7 +22,8 @@ int main(int argc, char* argv[]) {
 
     int x = inf.readInt();
     int n = inf.readInt();
-    cout << n << endl << flush;
+    bout << n << '\n';
+    bout.flush();
    	int lf = 1, rg = n;
 
     int queries = 0;
@@ -0,0 +1,180 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""This module defines benchmarking of solutions: running them on tests
+repeatedly and collecting statistics, which help to choose time limits."""
+
+import os
+import math
+import tempfile
+import statistics
+
+from pygon.testcase import Verdict
+from pygon.scheduler import Worker
+
+
+def percentile(values, q):
+    """Returns q-th percentile (0 <= q <= 100) of values
+    using the nearest-rank method."""
+
+    values = sorted(values)
+    rank = max(0, math.ceil(q / 100 * len(values)) - 1)
+    return values[rank]
+
+
+class Samples:
+    """Results of repeated runs of a solution on a test.
+
+    Attributes:
+        results: a list of InvokeResults.
+    """
+
+    def __init__(self, results):
+        self.results = results
+
+    @property
+    def times(self):
+        return [i.time for i in self.results]
+
+    @property
+    def min(self):
+        return min(self.times)
+
+    @property
+    def median(self):
+        return statistics.median(self.times)
+
+    @property
+    def p95(self):
+        return percentile(self.times, 95)
+
+    @property
+    def verdicts(self):
+        return {i.verdict for i in self.results}
+
+    def get_counter(self, name):
+        """Returns median of a hardware counter, or None if not collected."""
+
+        values = [i.counters[name] for i in self.results
+                  if i.counters and i.counters.get(name) is not None]
+
+        if not values:
+            return None
+
+        return statistics.median(values)
+
+
+def bench(solution, test, runs=5, warmup=1, cpu=None, counters=False,
+          time_limit=None):
+    """Runs a solution on a test repeatedly (without the checker).
+    Outputs are discarded.
+
+    Args:
+        solution: the Solution.
+        test: the SolutionTest.
+        runs: number of measured runs.
+        warmup: number of runs before the measured ones, which warm up
+                caches (of the disk, the CPU, etc).
+        cpu: CPU to pin the solution to, or None.
+        counters: whether to collect hardware counters.
+        time_limit: time limit in seconds (by default, the problem's).
+
+    Returns:
+        Samples: results of the measured runs.
+    """
+
+    results = []
+    worker = Worker(0, cpu=cpu)
+
+    try:
+        with tempfile.TemporaryDirectory() as dirname:
+            output = os.path.join(dirname, "output")
+
+            for i in range(warmup + runs):
+                res = solution.invoke(test, worker=worker, output=output,
+                                      time_limit=time_limit,
+                                      counters=counters)
+                if i >= warmup:
+                    results.append(res)
+    finally:
+        worker.close()
+
+    return Samples(results)
+
+
+def is_tl_solution(solution):
+    """Checks if solution is expected to get TL."""
+
+    return solution.tag.tag == "incorrect" and \
+        Verdict.TIME_LIMIT_EXCEEDED in solution.tag.verdicts
+
+
+def is_correct_solution(solution):
+    """Checks if solution is expected to get OK (i.e. main or correct)."""
+
+    return solution.tag.tag != "incorrect"
+
+
+def get_margin(solutions, samples):
+    """Compares correct solutions with solutions expected to get TL.
+
+    Args:
+        solutions: a list of Solutions.
+        samples: a list of lists, i-th list contains Samples of i-th
+                 solution on the tests.
+
+    Returns:
+        tuple: (slowest, fastest, ratio, proposal): slowest time of correct
+               solutions (95th percentile on their slowest test), fastest
+               time of TL solutions (minimum on their slowest test), ratio
+               between them, and the proposed time limit in seconds.
+               Missing values are None.
+    """
+
+    slowest = None
+    fastest = None
+
+    for solution, row in zip(solutions, samples):
+        if not row:
+            continue
+
+        if is_correct_solution(solution):
+            time = max(i.p95 for i in row)
+            slowest = time if slowest is None else max(slowest, time)
+        elif is_tl_solution(solution):
+            time = max(i.min for i in row)
+            fastest = time if fastest is None else min(fastest, time)
+
+    ratio = None
+    proposal = None
+
+    if slowest is not None and fastest is not None and slowest > 0:
+        ratio = fastest / slowest
+
+    if slowest is not None:
+        # At least twice the slowest correct solution, but if there are
+        # TL solutions, as far as possible from both sides.
+        proposal = 2 * slowest
+        if fastest is not None and fastest > slowest:
+            proposal = math.sqrt(slowest * fastest)
+        proposal = max(0.1, math.ceil(proposal * 10) / 10)
+
+    return slowest, fastest, ratio, proposal
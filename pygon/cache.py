@@ -0,0 +1,388 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""This module defines a content-addressed cache for build artifacts
+(executables, generated tests, outputs and verdicts).
+
+Every artifact is described by a key: a hash of everything it was
+produced from (contents of sources, inputs, commands, limits).
+The key is remembered in a stamp next to the artifact (in a hidden
+".stamps" directory), so an artifact is rebuilt only if its key changes,
+regardless of file modification times.
+
+Additionally, artifacts are stored in the cache directory under their
+keys, so that they can be reused by other problems or, if "cache_dir"
+is set in the config, by other checkouts or machines.
+
+Stored artifacts are deduplicated by their contents, and, if
+"cache_compression" is set in the config, compressed at rest.
+"""
+
+import os
+import stat
+import shutil
+import hashlib
+import tempfile
+import threading
+import subprocess
+
+from loguru import logger
+
+from pygon.config import CONFIG, BUILD_DIR
+
+_hashes = {}
+_hashes_guard = threading.Lock()
+
+
+def hash_file(path):
+    """Returns a hex SHA-256 digest of a file's contents.
+    Digests are memoised while the file's size and mtime stay the same.
+
+    Raises:
+        OSError: if the file doesn't exist or is inaccessible.
+    """
+
+    path = os.path.abspath(path)
+    stat = os.stat(path)
+    stamp = (stat.st_ino, stat.st_size, stat.st_mtime_ns)
+
+    with _hashes_guard:
+        cached = _hashes.get(path)
+
+    if cached and cached[0] == stamp:
+        return cached[1]
+
+    digest = hashlib.sha256()
+
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            digest.update(chunk)
+
+    res = digest.hexdigest()
+
+    with _hashes_guard:
+        _hashes[path] = (stamp, res)
+
+    return res
+
+
+def hash_dir(path):
+    """Returns a hex SHA-256 digest of names and contents of all files
+    inside a directory (recursively). Missing directory has a digest, too.
+    """
+
+    parts = []
+
+    for dirpath, dirnames, filenames in os.walk(path):
+        dirnames.sort()
+        for name in sorted(filenames):
+            full = os.path.join(dirpath, name)
+            parts.append(os.path.relpath(full, path))
+            parts.append(hash_file(full))
+
+    return make_key(*parts)
+
+
+def make_key(*parts):
+    """Combines parts (strings or None) into a single hex SHA-256 digest."""
+
+    digest = hashlib.sha256()
+
+    for part in parts:
+        digest.update(repr(part).encode())
+        digest.update(b"\0")
+
+    return digest.hexdigest()
+
+
+def get_stamp_path(path):
+    """Returns path to the stamp of the artifact at path."""
+
+    return os.path.join(os.path.dirname(path), ".stamps",
+                        os.path.basename(path))
+
+
+def read_stamp(path):
+    """Returns key the artifact at path was built with, or None."""
+
+    try:
+        with open(get_stamp_path(path)) as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+
+def write_stamp(path, key):
+    """Remembers that the artifact at path was built with key."""
+
+    stamp = get_stamp_path(path)
+    os.makedirs(os.path.dirname(stamp), exist_ok=True)
+
+    with open(stamp, "w") as f:
+        f.write(key)
+
+
+def remove_stamps(paths):
+    """Forgets keys of artifacts and removes them (e.g. before rebuilding
+    them), so that half-built artifacts are never considered fresh.
+    Rebuilt artifacts are new files, hence their hardlinked copies
+    (e.g. in exports) keep the old contents.
+    """
+
+    for path in paths:
+        for i in (get_stamp_path(path), path):
+            try:
+                os.remove(i)
+            except OSError:
+                pass
+
+
+def is_fresh(paths, key):
+    """Checks if all artifacts exist and were built with key."""
+
+    return all(os.path.exists(i) and read_stamp(i) == key for i in paths)
+
+
+def _zstd(args, src, dst):
+    with open(dst, "wb") as f:
+        if subprocess.run(["zstd", "-q", "-c"] + args + [src],
+                          stdout=f).returncode:
+            raise OSError("zstd failed on {}".format(src))
+
+
+def _place(src, dst, link=True, compress=False, decompress=False, copy=True):
+    """Atomically replaces dst with a copy of src (a hardlink if link is
+    set and it's possible), optionally (de)compressing it with zstd.
+    If copy is not set, only a hardlink is made (or OSError is raised)."""
+
+    os.makedirs(os.path.dirname(dst), exist_ok=True)
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(dst),
+                               prefix=".{}.".format(os.path.basename(dst)))
+    os.close(fd)
+    try:
+        if compress or decompress:
+            _zstd(["-d"] if decompress else [], src, tmp)
+            shutil.copystat(src, tmp)
+        else:
+            os.remove(tmp)
+            try:
+                if not link:
+                    raise OSError
+                os.link(src, tmp)
+            except OSError:
+                if not copy:
+                    raise
+                shutil.copy2(src, tmp)
+        os.replace(tmp, dst)
+    except BaseException:
+        if os.path.exists(tmp):
+            os.remove(tmp)
+        raise
+
+
+_warned = set()
+
+
+def get_compression():
+    """Returns the compression of caches set in the config ("zstd"),
+    or None if it isn't set or isn't available."""
+
+    compression = CONFIG.get("cache_compression")
+
+    if not compression:
+        return None
+
+    if compression != "zstd" or not shutil.which("zstd"):
+        if compression not in _warned:
+            _warned.add(compression)
+            logger.warning("Cache compression {} is not available, "
+                           "artifacts are stored uncompressed", compression)
+        return None
+
+    return compression
+
+
+class Cache:
+    """A content-addressed store of artifacts.
+
+    Artifacts with the same contents are stored once: objects are
+    hardlinks to blobs in the "blobs" directory, named by the contents.
+    Uncompressed blobs are hardlinked to the artifacts' places, too
+    (when they are stored or fetched), so that, for example, equal
+    outputs of all solutions take the space of one. Hence artifacts
+    should be replaced with new files instead of being modified in place,
+    see remove_stamps.
+
+    With compression only the blobs are compressed, the artifacts'
+    places get uncompressed files. Equal artifacts still share one of them:
+    the first working copy of every blob is recorded next to it
+    (in a ".copy" file), and the later ones are hardlinked to it.
+
+    Attributes:
+        directory: path to the store.
+        compression: None or "zstd": blobs are compressed with the zstd
+            command at rest, and decompressed to the artifacts' places.
+    """
+
+    SUFFIXES = {None: "", "zstd": ".zst"}
+
+    def __init__(self, directory, compression=None):
+        self.directory = directory
+        self.compression = compression
+
+    @classmethod
+    def get(cls, root):
+        """Returns the cache configured for a build root.
+
+        Args:
+            root: directory, containing BUILD_DIR (e.g. problem's root).
+        """
+
+        directory = CONFIG.get("cache_dir")
+        if directory:
+            directory = os.path.expanduser(directory)
+        else:
+            directory = os.path.join(root, BUILD_DIR, "cache")
+
+        return cls(directory, compression=get_compression())
+
+    def get_object_path(self, key, name):
+        """Returns path to the stored artifact named name with key
+        (without the compression's suffix)."""
+
+        return os.path.join(self.directory, key[:2], key, name)
+
+    def find_object(self, key, name):
+        """Returns path to the stored artifact named name with key,
+        either compressed or not, or None if it's not stored."""
+
+        path = self.get_object_path(key, name)
+
+        for suffix in self.SUFFIXES.values():
+            if os.path.exists(path + suffix):
+                return path + suffix
+
+        return None
+
+    def get_blob_path(self, path):
+        """Returns path to the blob for the contents of file at path."""
+
+        digest = make_key(hash_file(path),
+                          stat.S_IMODE(os.stat(path).st_mode))
+
+        return os.path.join(self.directory, "blobs", digest[:2],
+                            digest + self.SUFFIXES[self.compression])
+
+    def contains(self, key, names):
+        """Checks if all named artifacts with key are stored."""
+
+        return all(self.find_object(key, i) for i in names)
+
+    def fetch(self, key, artifacts):
+        """Copies stored artifacts to their places and stamps them.
+
+        Args:
+            key: key of the artifacts.
+            artifacts: dict, mapping artifact names to destination paths.
+
+        Returns:
+            bool: True if all artifacts were found, and False otherwise.
+        """
+
+        if not self.contains(key, artifacts):
+            return False
+
+        try:
+            for name, path in artifacts.items():
+                obj = self.find_object(key, name)
+                compressed = obj.endswith(".zst")
+                _place(obj, path, decompress=compressed)
+                if compressed:
+                    self.share_copy(self.get_blob_path(path), path)
+                write_stamp(path, key)
+        except OSError:
+            return False
+
+        return True
+
+    def store(self, key, artifacts):
+        """Stamps artifacts and puts them into the store.
+
+        Args:
+            key: key of the artifacts.
+            artifacts: dict, mapping artifact names to their paths.
+        """
+
+        compress = self.compression is not None
+        suffix = self.SUFFIXES[self.compression]
+
+        for name, path in artifacts.items():
+            write_stamp(path, key)
+            try:
+                blob = self.get_blob_path(path)
+
+                if not os.path.exists(blob):
+                    _place(path, blob, compress=compress)
+                elif not compress and not os.path.samefile(blob, path):
+                    # An equal artifact is stored: share its blob.
+                    _place(blob, path)
+
+                if compress:
+                    self.share_copy(blob, path)
+
+                _place(blob, self.get_object_path(key, name) + suffix)
+            except OSError:
+                pass
+
+    def share_copy(self, blob, path):
+        """Hardlinks the artifact at path to the recorded working copy
+        of the compressed blob with the same contents, or records
+        the artifact as the working copy if there's none (or it has
+        been replaced since)."""
+
+        path = os.path.abspath(path)
+        record = blob + ".copy"
+
+        try:
+            with open(record) as f:
+                copy = f.read()
+        except OSError:
+            copy = None
+
+        if copy and copy != path:
+            try:
+                if os.path.samefile(copy, path):
+                    return
+                if self.get_blob_path(copy) == blob:
+                    _place(copy, path, copy=False)
+                    return
+            except OSError:
+                pass
+
+        try:
+            fd, tmp = tempfile.mkstemp(
+                dir=os.path.dirname(blob),
+                prefix=".{}.".format(os.path.basename(record)))
+            with os.fdopen(fd, "w") as f:
+                f.write(path)
+            os.replace(tmp, record)
+        except OSError:
+            pass
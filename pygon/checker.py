@@ -21,17 +21,88 @@
 
 """This module defines class for working with checkers."""
 
+import os
 import subprocess
 from collections import namedtuple
 
+import yaml
+
+from pygon.language import Language
 from pygon.source import Source
 from pygon.testcase import Verdict
+from pygon.tracing import span
 
 
 class CheckerVerdict(namedtuple('CheckerVerdict', 'verdict comment')):
     """Checker's verdict on a solution with a comment."""
 
 
+def get_checker_verdict(returncode, comment):
+    """Converts checker's exit code and message into a CheckerVerdict."""
+
+    verdict = Verdict.CHECK_FAILED
+    if returncode == 0:
+        verdict = Verdict.OK
+    elif returncode == 1:
+        verdict = Verdict.WRONG_ANSWER
+    elif returncode == 2:
+        verdict = Verdict.PRESENTATION_ERROR
+
+    return CheckerVerdict(verdict, comment.strip())
+
+
+class CheckerProcess:
+    """A checker process, running in batch mode (see runTestlibChecker
+    in testlib.h): it reads NUL-terminated triples of paths from stdin
+    and prints a line "<exit code> <message>" for each of them.
+    Restarted automatically if it dies.
+    """
+
+    def __init__(self, checker):
+        self.checker = checker
+        self.process = None
+
+    def _start(self):
+        self.process = subprocess.Popen(
+            self.checker.get_execute_command() + ["--batch"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL)
+
+    def judge(self, inp, out, ans):
+        """See Checker.judge."""
+
+        request = b"".join(os.fsencode(i) + b"\0" for i in (inp, out, ans))
+
+        for attempt in range(2):
+            if not self.process or self.process.poll() is not None:
+                self._start()
+
+            try:
+                self.process.stdin.write(request)
+                self.process.stdin.flush()
+                line = self.process.stdout.readline().decode(errors="replace")
+            except OSError:
+                line = ""
+
+            if line:
+                code, _, comment = line.rstrip("\n").partition(" ")
+                return get_checker_verdict(int(code), comment)
+
+            self.close()
+
+        return CheckerVerdict(Verdict.CHECK_FAILED,
+                              "Checker died in batch mode")
+
+    def close(self):
+        """Stops the checker process."""
+
+        if self.process:
+            self.process.stdin.close()
+            self.process.wait()
+            self.process.stdout.close()
+            self.process = None
+
+
 class Checker(Source):
     """A checker for a problem"""
 
@@ -41,6 +112,8 @@ class Checker(Source):
         "hcmp",
         "lcmp",
         "ncmp",
+        "rcmp6",
+        "rcmp9",
         "wcmp",
         "yesno",
     ]
@@ -55,11 +128,39 @@ class Checker(Source):
             name: name of the checker with extension (e.g. "checker.cpp").
             problem: Problem which this checker belongs to.
             lang: Language of the checker.
+            batch: whether the checker supports batch mode.
         """
 
+        self.batch = kwargs.pop("batch", False)
         super(Checker, self).__init__(**kwargs)
 
-    def judge(self, inp, out, ans):
+    def load(self):
+        """See base class."""
+
+        with open(self.get_descriptor_path()) as desc:
+            data = yaml.safe_load(desc)
+
+        self.lang = Language.from_name(data.get('language'))
+        self.batch = data.get('batch', False)
+
+    def save(self):
+        """See base class."""
+
+        with open(self.get_descriptor_path(), "w") as desc:
+            data = dict(language=self.lang.name)
+            if self.batch:
+                data["batch"] = True
+            yaml.dump(data, desc, default_flow_style=False)
+
+    def supports_batch(self):
+        """Whether the checker supports batch mode. Standard checkers do,
+        custom ones must use runTestlibChecker and set "batch: true"
+        in their descriptors.
+        """
+
+        return bool(self.standard or self.batch)
+
+    def judge(self, inp, out, ans, worker=None):
         """Judges a solution on a test.
         Expects checker to be already compiled.
 
@@ -67,21 +168,22 @@ class Checker(Source):
             inp: path to the test's input file.
             out: path to the solution's output on this test.
             ans: path to the correct solution's output on this test.
+            worker (Worker): if set and the checker supports batch mode,
+                             the worker's checker process judges the test.
 
         Returns:
             CheckerVerdict: instance containing the judgement.
         """
 
-        cmd = self.get_execute_command()
-        cmd += [inp, out, ans]
-        res = subprocess.run(cmd, stderr=subprocess.PIPE,
-                             universal_newlines=True)
-        verdict = Verdict.CHECK_FAILED
-        if res.returncode == 0:
-            verdict = Verdict.OK
-        elif res.returncode == 1:
-            verdict = Verdict.WRONG_ANSWER
-        elif res.returncode == 2:
-            verdict = Verdict.PRESENTATION_ERROR
-
-        return CheckerVerdict(verdict, res.stderr.strip())
+        with span("{} on {}".format(self.identifier, out), "check"):
+            if worker and self.supports_batch():
+                process = worker.get(("checker", self.get_executable_path()),
+                                     lambda: CheckerProcess(self))
+                return process.judge(inp, out, ans)
+
+            cmd = self.get_execute_command()
+            cmd += [inp, out, ans]
+            res = subprocess.run(cmd, stderr=subprocess.PIPE,
+                                 universal_newlines=True)
+
+            return get_checker_verdict(res.returncode, res.stderr)
@@ -25,6 +25,7 @@ import os
 import sys
 import re
 import tempfile
+import subprocess
 
 import click
 from tabulate import tabulate
@@ -38,8 +39,14 @@ from pygon.validator import Validator
 from pygon.generator import Generator
 from pygon.solution import Solution
 from pygon.interactor import Interactor
-from pygon.testcase import SolutionTest, expand_generator_command
+from pygon.testcase import Verdict, iter_generator_command, count_generator_command
+from pygon.testcase import sample_generator_command
 from pygon.ejudge import write_script as write_ejudge_script
+from pygon.ejudge import write_archive as write_ejudge_archive
+from pygon import tracing
+from pygon.bench import bench as run_bench, get_margin
+from pygon.scheduler import get_cpus
+from pygon.invoke import read_trace, summarize_trace
 
 
 def get_problem():
@@ -83,9 +90,23 @@ def get_problem_or_contest():
     sys.exit(1)
 
 
+def report_profile(path):
+    tracing.write_trace(path)
+
+    data = [[phase, count, "{:.3f}".format(wall), "{:.3f}".format(cpu)]
+            for phase, count, wall, cpu in tracing.summarize()]
+
+    click.echo(tabulate(data, ["Phase", "Spans", "Wall, s", "CPU, s"],
+                        tablefmt="presto"), err=True)
+    click.echo("Trace written to {}".format(path), err=True)
+
+
 @click.group()
 @click.option("-v", "--verbose", count=True, help="Show more output")
-def cli(verbose):
+@click.option("--profile", type=click.Path(dir_okay=False),
+              help="Collect timings of phases, write them to this file "
+                   "as a Chrome trace and show a summary")
+def cli(verbose, profile):
     if verbose == 1:
         CONFIG["level"] = "INFO"
     elif verbose > 1:
@@ -93,6 +114,11 @@ def cli(verbose):
 
     switch_logger()
 
+    if profile:
+        tracing.enable()
+        click.get_current_context().call_on_close(
+            lambda: report_profile(profile))
+
 @click.command(help="Create a new problem")
 @click.argument("name")
 def init(name):
@@ -133,6 +159,9 @@ time_limit: 1.0
 # Memory limit per test in MiB.
 memory_limit: 256
 
+# Output limit per test in MiB, a solution writing more gets OL.
+output_limit: 256
+
 # Active checker, default is probably good enough if you have single possible answer.
 active_checker: standard.lcmp
 
@@ -183,12 +212,20 @@ date:
 
 @click.command(help="Export problem or contest to ejudge")
 @click.option("-l", "--language", help="Language for full problem names (e.g. \"english\")")
-def ejudgeexport(language=None):
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of jobs to run simultaneously (0 = number of CPUs)")
+@click.option("-a", "--archive",
+              help="Also write the export to an archive "
+                   "(e.g. \"contest.tar.zst\", \"contest.tar.gz\")")
+def ejudgeexport(language=None, jobs=1, archive=None):
     prob = get_problem_or_contest()
 
     try:
-        prob.build(statements=False)
-        prob.ejudge_export(language=language)
+        prob.build(statements=False, jobs=jobs)
+        prob.ejudge_export(language=language, jobs=jobs)
+        if archive:
+            write_ejudge_archive(os.path.join(prob.root, BUILD_DIR, "ejudge"),
+                                 archive)
     except ProblemConfigurationError as e:
         logger.error("Problem configuration error: {}", str(e))
         sys.exit(1)
@@ -197,12 +234,14 @@ def ejudgeexport(language=None):
 @click.command(help="Print ejudge deployment script")
 @click.option("-l", "--language", help="Language for full problem names (e.g. \"english\")")
 @click.option("-d", "--directory", help="Directory for contest (e.g. \"/home/judges/000001\")")
-def ejudgedeploy(language=None, directory=None):
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of jobs to run simultaneously (0 = number of CPUs)")
+def ejudgedeploy(language=None, directory=None, jobs=1):
     cont = get_problem_or_contest()
 
     try:
-        cont.build(statements=False)
-        cont.ejudge_export(language=language)
+        cont.build(statements=False, jobs=jobs)
+        cont.ejudge_export(language=language, jobs=jobs)
         write_ejudge_script(os.path.join(cont.root, BUILD_DIR, "ejudge"), contest_dir=directory)
     except ProblemConfigurationError as e:
         logger.error("Problem configuration error: {}", str(e))
@@ -212,22 +251,28 @@ def ejudgedeploy(language=None, directory=None):
 @click.command(help="Build problem or contest")
 @click.option("--statements/--no-statements", help="Build statements?",
               default=True, show_default=True)
-def build(statements):
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of tests to process simultaneously (0 = number of CPUs)")
+def build(statements, jobs):
     prob = get_problem_or_contest()
 
     try:
-        prob.build(statements=statements)
+        prob.build(statements=statements, jobs=jobs)
     except ProblemConfigurationError as e:
         logger.error("Problem configuration error: {}", str(e))
         sys.exit(1)
 
 
 @click.command(help="Lint problem or contest for configuration errors")
-def verify():
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of solutions to run simultaneously (0 = number of CPUs)")
+@click.option("-f", "--fail-fast", is_flag=True,
+              help="Stop running a solution once its tag is known to be (in)correct")
+def verify(jobs, fail_fast):
     prob = get_problem_or_contest()
 
     try:
-        prob.verify()
+        prob.verify(jobs=jobs, fail_fast=fail_fast)
     except ProblemConfigurationError as e:
         logger.error("Problem configuration error: {}", str(e))
         sys.exit(1)
@@ -262,10 +307,49 @@ def addstatement(language, name):
     prob.add_statement(language, name)
 
 
+def select_tests(prob, tests):
+    if not tests:
+        return prob.get_solution_tests()
+
+    res = []
+    for i in tests.split(","):
+        if "-" in i:
+            begin, end = map(int, i.split("-"))
+            res += list(range(begin, end+1))
+        else:
+            res.append(int(i))
+
+    res = set(res)
+    return [i for i in prob.get_solution_tests() if i.index in res]
+
+
+def select_solutions(prob, solutions):
+    if not solutions:
+        solutions = Solution.all(prob)
+    else:
+        solutions = [Solution.from_identifier(i, prob) for i in solutions.split(",")]
+
+    for solution in solutions:
+        try:
+            solution.ensure_compile()
+        except subprocess.CalledProcessError:
+            logger.error("Solution {} compilation failed", solution.identifier)
+            sys.exit(1)
+
+    return solutions
+
+
 @click.command(help="Run solutions on tests")
 @click.option("-t", "--tests", help="Comma-separated subset of tests to run (default: all)")
 @click.option("-s", "--solutions", help="Comma-separated subset of solutions to run (default: all)")
-def invoke(tests=None, solutions=None):
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of solutions to run simultaneously (0 = number of CPUs)")
+@click.option("-f", "--fail-fast", is_flag=True,
+              help="Stop running a solution once its tag is known to be (in)correct")
+@click.option("--trace", is_flag=True,
+              help="Run solutions once more, sampling their resource usage, "
+                   "and summarise it")
+def invoke(tests=None, solutions=None, jobs=1, fail_fast=False, trace=False):
     prob = get_problem()
 
     try:
@@ -274,51 +358,41 @@ def invoke(tests=None, solutions=None):
         logger.error("Problem configuration error: {}", str(e))
         sys.exit(1)
 
-    if not tests:
-        tests = prob.get_solution_tests()
-    else:
-        res = []
-        for i in tests.split(","):
-            if "-" in i:
-                begin, end = map(int, i.split("-"))
-                res += list(range(begin, end+1))
-            else:
-                res.append(int(i))
-        tests = []
-        res = set(res)
-        for test in prob.get_solution_tests():
-            if test.index in res:
-                tests.append(test)
-
-    if not solutions:
-        solutions = Solution.all(prob)
-    else:
-        solutions = [Solution.from_identifier(i, prob) for i in solutions.split(",")]
+    tests = select_tests(prob, tests)
+    solutions = select_solutions(prob, solutions)
 
     header = ["Test"] + [i.name for i in solutions]
     data = []
     verdicts = [[] for _ in solutions]
 
-    need_judging = 0
+    need_judging = set()
 
     for test in tests:
         for solution in solutions:
             if solution.need_judge(test):
-                need_judging += 1
-
-    with click.progressbar(length=need_judging) as bar:
-        for test in tests:
-            data.append([str(test.index)])
-            for i, solution in enumerate(solutions):
-                if solution.need_judge(test):
-                    bar.update(1)
-                res = solution.judge(test)
-                verdicts[i].append(res.verdict)
-                s = click.style(res.verdict.value, fg="green" if
-                                solution.tag.check_one(res.verdict) else "red",
-                                bold=True)
-                s += " {:>4} ms {:>3} MiB".format(round(res.time * 1000), round(res.memory))
-                data[-1].append(s)
+                need_judging.add((solution.identifier, test.index))
+
+    def progress(solution, test, res):
+        if (solution.identifier, test.index) in need_judging:
+            bar.update(1)
+
+    with click.progressbar(length=len(need_judging)) as bar:
+        results = prob.judge_solutions(solutions, tests, jobs=jobs,
+                                       fail_fast=fail_fast, callback=progress)
+
+    for j, test in enumerate(tests):
+        data.append([str(test.index)])
+        for i, solution in enumerate(solutions):
+            res = results[i][j]
+            if res is None:
+                data[-1].append(click.style("skipped", dim=True))
+                continue
+            verdicts[i].append(res.verdict)
+            s = click.style(res.verdict.value, fg="green" if
+                            solution.tag.check_one(res.verdict) else "red",
+                            bold=True)
+            s += " {:>4} ms {:>3} MiB".format(round(res.time * 1000), round(res.memory))
+            data[-1].append(s)
 
     data.append(["Tag correct?"])
     exitcode = 0
@@ -332,17 +406,135 @@ def invoke(tests=None, solutions=None):
         data[-1].append(s)
 
     click.echo(tabulate(data, header, tablefmt="presto"))
+
+    if trace:
+        trace_solutions(solutions, tests)
+
     sys.exit(exitcode)
 
 
+def trace_solutions(solutions, tests):
+    """Runs solutions on tests with resource usage sampling, saving traces
+    next to the outputs, and prints a summary of them."""
+
+    if sys.platform in ["win32", "cygwin"]:
+        logger.warning("Tracing is not supported on Windows")
+        return
+
+    header = ["Test"] + ["{} (peak/avg MiB, CPU)".format(i.name)
+                         for i in solutions]
+    data = [[str(test.index)] for test in tests]
+
+    with click.progressbar(length=len(tests) * len(solutions)) as bar, \
+            tempfile.TemporaryDirectory() as tmp:
+        for solution in solutions:
+            for j, test in enumerate(tests):
+                path = test.get_trace_path(solution.identifier)
+                os.makedirs(os.path.dirname(path), exist_ok=True)
+                solution.invoke(test, output=os.path.join(tmp, "output"),
+                                trace=path)
+                bar.update(1)
+
+                summary = summarize_trace(read_trace(path))
+                if summary is None:
+                    data[j].append(click.style("no samples", dim=True))
+                    continue
+
+                s = "{:.0f}/{:.0f} {:>3.0f}%".format(
+                    summary["peak_rss"], summary["average_rss"],
+                    100 * summary["cpu_share"])
+                if summary["flags"]:
+                    s += " " + click.style(",".join(summary["flags"]),
+                                           fg="yellow")
+                data[j].append(s)
+
+    click.echo(tabulate(data, header, tablefmt="presto"))
+
+
+@click.command(help="Benchmark solutions with repeated runs")
+@click.option("-t", "--tests", help="Comma-separated subset of tests to run (default: all)")
+@click.option("-s", "--solutions", help="Comma-separated subset of solutions to run (default: all)")
+@click.option("-n", "--runs", type=int, default=5, show_default=True,
+              help="Number of measured runs per test")
+@click.option("-w", "--warmup", type=int, default=1, show_default=True,
+              help="Number of unmeasured runs per test before measured ones")
+@click.option("--cpu", type=int, help="CPU to pin solutions to (default: first available)")
+@click.option("--counters", is_flag=True,
+              help="Collect hardware counters (Linux perf events)")
+@click.option("--tl-factor", type=float, default=3.0, show_default=True,
+              help="Run with time limit this many times the problem's one")
+def bench(tests, solutions, runs, warmup, cpu, counters, tl_factor):
+    prob = get_problem()
+
+    try:
+        prob.build(statements=False)
+    except ProblemConfigurationError as e:
+        logger.error("Problem configuration error: {}", str(e))
+        sys.exit(1)
+
+    tests = select_tests(prob, tests)
+    solutions = select_solutions(prob, solutions)
+
+    if cpu is None:
+        cpu = get_cpus()[0]
+
+    header = ["Test"] + ["{} (min/med/p95 ms)".format(i.name) for i in solutions]
+    data = [[str(test.index)] for test in tests]
+    samples = [[] for _ in solutions]
+
+    with click.progressbar(length=len(tests) * len(solutions)) as bar:
+        for i, solution in enumerate(solutions):
+            for j, test in enumerate(tests):
+                res = run_bench(solution, test, runs=runs, warmup=warmup,
+                                cpu=cpu, counters=counters,
+                                time_limit=tl_factor * prob.time_limit)
+                samples[i].append(res)
+                bar.update(1)
+
+    for i, solution in enumerate(solutions):
+        for j, res in enumerate(samples[i]):
+            s = "{:.0f}/{:.0f}/{:.0f}".format(1000 * res.min, 1000 * res.median,
+                                              1000 * res.p95)
+            if res.verdicts != {Verdict.OK}:
+                s += " " + ",".join(sorted(v.value for v in res.verdicts))
+            if counters:
+                instructions = res.get_counter("instructions")
+                misses = res.get_counter("cache_misses")
+                if instructions is None:
+                    s += " (no counters)"
+                else:
+                    s += " {:.1f}M instr, {:.1f}K misses".format(
+                        instructions / 1e6, (misses or 0) / 1e3)
+            data[j].append(s)
+
+    click.echo(tabulate(data, header, tablefmt="presto"))
+
+    slowest, fastest, ratio, proposal = get_margin(solutions, samples)
+
+    if slowest is not None:
+        click.echo("Slowest correct solution: {:.0f} ms".format(1000 * slowest))
+    if fastest is not None:
+        click.echo("Fastest TL solution: {:.0f} ms".format(1000 * fastest))
+    if ratio is not None:
+        click.echo("TL margin ratio: {:.2f}".format(ratio))
+    if proposal is not None:
+        click.echo("Proposed time limit: {:.1f} s (current: {} s)".format(
+            proposal, prob.time_limit))
+
+
 @click.command(help="Stress-test solutions for tag violations")
 @click.option("-s", "--solutions", help="Comma-separated subset of solutions to run (default: all except main)")
+@click.option("-j", "--jobs", type=int, default=1, show_default=True,
+              help="Number of tests to process simultaneously (0 = number of CPUs)")
+@click.option("--samples", type=int,
+              help="Run on this many random distinct commands instead of all of them")
+@click.option("--seed", help="Seed for choosing random commands")
 @click.argument("command")
-def stress(command, solutions):
+def stress(command, solutions, jobs, samples, seed):
     prob = get_problem()
 
     try:
-        prob.build(statements=False)
+        prob.build(statements=False, jobs=jobs)
     except ProblemConfigurationError as e:
         logger.error("Problem configuration error: {}", str(e))
         sys.exit(1)
@@ -356,42 +548,30 @@ def stress(command, solutions):
         logger.warning("No solutions to stress")
         return
 
-    commands = expand_generator_command(command)
-
-    offenders = {}
-    verdicts = {}
-
     for solution in solutions:
-        offenders[solution.name] = None
-        verdicts[solution.name] = set()
+        solution.ensure_compile()
 
-    main_solution = prob.get_main_solution()
+    total = count_generator_command(command)
+
+    if samples is None:
+        commands = iter_generator_command(command)
+    else:
+        commands = sample_generator_command(command, samples, seed=seed)
+        total = min(total, samples)
 
     with tempfile.TemporaryDirectory() as dirname:
-        with click.progressbar(commands) as bar:
-            for cmd in bar:
-                test = SolutionTest(problem=prob, generate=cmd,
-                                    dirname=dirname)
-                test.build()
-                main_solution.judge(test)
-                failed = set()
-                for i, solution in enumerate(solutions):
-                    res = solution.judge(test)
-                    verdicts[solution.name].add(res.verdict)
-                    if not solution.tag.check_one(res.verdict):
-                        offenders[solution.name] = cmd
-                        failed.add(i)
-                solutions = [x for i, x in enumerate(solutions) if i not in failed]
-                if not solutions:
-                    break
-
-    for solution, cmd in offenders.items():
-        click.echo("{} displayed verdicts: ".format(click.style(solution, bold=True)), nl=False)
-        click.echo(", ".join([i.styled for i in verdicts[solution]]), nl=False)
-        if cmd is None:
+        with click.progressbar(length=total) as bar:
+            offenders, verdicts = prob.stress(
+                solutions, commands, dirname, jobs=jobs,
+                callback=lambda cmd: bar.update(1))
+
+    for i, solution in enumerate(solutions):
+        click.echo("{} displayed verdicts: ".format(click.style(solution.name, bold=True)), nl=False)
+        click.echo(", ".join([v.styled for v in verdicts[i]]), nl=False)
+        if offenders[i] is None:
             click.echo(" (no counterexample found)")
         else:
-            click.echo(" (found counterexample: {})".format(cmd))
+            click.echo(" (found counterexample: {})".format(offenders[i]))
 
 
 cli.add_command(init)
@@ -402,6 +582,7 @@ cli.add_command(discover)
 cli.add_command(edittests)
 cli.add_command(addstatement)
 cli.add_command(invoke)
+cli.add_command(bench)
 cli.add_command(stress)
 cli.add_command(ejudgeexport)
 cli.add_command(ejudgedeploy)
@@ -67,6 +67,27 @@ languages:
 
 # Default log level
 level: SUCCESS
+
+# Optional directory for the cache of build artifacts (executables,
+# generated tests, outputs and verdicts), keyed by their contents.
+# By default every problem has its own cache in pygon-build/cache.
+# A shared directory lets problems, checkouts or machines reuse the work.
+# cache_dir: "~/.cache/pygon"
+
+# Executables are shared by all problems of the user (like ccache) and
+# are stored in cache_dir or, if it's not set, in ~/.cache/pygon/executables.
+# Set to "" to keep them in the problem's own cache.
+# compile_cache_dir: "~/.cache/pygon/executables"
+
+# Optional compression of caches at rest: "zstd" (requires the zstd command).
+# Only the cache's copies are compressed: artifacts in pygon-build are
+# decompressed to their places (equal ones are hardlinked to one copy).
+# cache_compression: zstd
+
+# Optional cgroup v2 directory, writable by the current user (on Linux).
+# If set, solutions are run in their own cgroups inside it, which gives
+# precise CPU time and memory usage, including all threads and children.
+# cgroup: "/sys/fs/cgroup/user.slice/user-1000.slice/user@1000.service/pygon"
 """
 
 
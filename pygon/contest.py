@@ -22,7 +22,8 @@
 """This module defines class for working with contests."""
 
 import os
-from shutil import rmtree
+import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
 
 import yaml
 import click
@@ -30,21 +31,30 @@ from loguru import logger
 from pkg_resources import resource_filename
 
 from pygon.config import BUILD_DIR, CONFIG
-from pygon.problem import Problem
+from pygon.problem import Problem, ProblemConfigurationError
 from pygon.statement import Statement
 from pygon.ejudge import export_contest as ejudge_export
+from pygon.scheduler import use_pool, get_context, run_in_context
+from pygon.tracing import traced
 
-
-def switch_logger(problem=None):
+def _format(record):
+    # Name of the problem, messages are logged for (in the thread's context).
+    problem = get_context().get("problem")
     if problem:
         p = "[ {} ]".format(problem)
     else:
         p = ""
 
+    return "<level>P</level> <level>{level:<8}</level> <level>{message}</level>\n{exception}".replace("P", p)
+
+
+def switch_logger(problem=None):
+    get_context()["problem"] = problem
+
     logger.remove()
     logger.add(lambda x: click.echo(x, nl=False, err=True),
                level=CONFIG["level"],
-               format="<level>P</level> <level>{level:<8}</level> <level>{message}</level>".replace("P", p),
+               format=_format,
                colorize=True)
 
 
@@ -88,14 +98,82 @@ class Contest:
 
         return list(set(list(self.name) + list(self.location) + list(self.date)))
 
-    def build(self, statements=True):
-        """Build the contest."""
-
-        for prefix, problem in self.problems:
-            switch_logger(problem.internal_name)
-            problem.build(statements=statements)
-
-        switch_logger()
+    def for_each_problem(self, func, jobs=1):
+        """Runs func(problem, pool) for all problems simultaneously,
+        sharing a single Pool, and reports progress. Messages func logs
+        are prefixed with the problem's name. With one job at a time,
+        problems are processed one by one.
+
+        Args:
+            func: the job.
+            jobs: number of jobs to run simultaneously
+                  (0 means the number of CPUs).
+
+        Raises:
+            ProblemConfigurationError: if any of the problems fails
+                                       (its error is logged, too).
+        """
+
+        def job(problem, pool):
+            get_context()["problem"] = problem.internal_name
+            start = time.perf_counter()
+            try:
+                func(problem, pool)
+            except ProblemConfigurationError as e:
+                logger.error("Problem configuration error: {}", str(e))
+                return e, time.perf_counter() - start
+            return None, time.perf_counter() - start
+
+        problems = [problem for prefix, problem in self.problems]
+        done = []
+        failed = []
+
+        def report(problem, res):
+            done.append(problem)
+            if res[0]:
+                failed.append(problem.internal_name)
+
+            # Logged at the default level, so that progress is always seen.
+            log = logger.error if res[0] else logger.success
+            log("[{}/{}] {} {} in {:.1f} s", len(done), len(problems),
+                problem.internal_name, "failed" if res[0] else "done", res[1])
+
+        with use_pool(jobs) as pool:
+            if pool.jobs == 1:
+                for problem in problems:
+                    report(problem, run_in_context(
+                        get_context(), job, problem, pool))
+                    if failed:
+                        break
+            else:
+                with ThreadPoolExecutor(max_workers=len(problems) or 1) as ex:
+                    futures = {ex.submit(run_in_context, dict(get_context()),
+                                         job, problem, pool): problem
+                               for problem in problems}
+                    for future in as_completed(futures):
+                        report(futures[future], future.result())
+
+        if failed:
+            raise ProblemConfigurationError(
+                "Problems failed: {}".format(", ".join(
+                    p.internal_name for p in problems
+                    if p.internal_name in failed)))
+
+    @traced("build")
+    def build(self, statements=True, jobs=1):
+        """Build the contest. Problems are built simultaneously,
+        sharing one pool of jobs (see Contest.for_each_problem).
+
+        Args:
+            statements: whether to build statements.
+            jobs: number of jobs to run simultaneously
+                  (0 means the number of CPUs).
+        """
+
+        self.for_each_problem(
+            lambda problem, pool: problem.build(statements=statements,
+                                                pool=pool),
+            jobs=jobs)
 
         if statements:
             for lang in self.get_languages():
@@ -105,26 +183,40 @@ class Contest:
                                         date=self.date.get(lang, ""))
                 stmt.build()
 
-    def verify(self):
-        """Run verification on all problems."""
+    @traced("verify")
+    def verify(self, jobs=1, fail_fast=False):
+        """Run verification on all problems. Problems are verified
+        simultaneously, sharing one pool of jobs
+        (see Contest.for_each_problem).
 
-        for prefix, problem in self.problems:
-            switch_logger(problem.internal_name)
-            problem.verify()
+        Args:
+            jobs: number of jobs to run simultaneously
+                  (0 means the number of CPUs).
+            fail_fast: stop judging solutions once their tag check is decided.
+        """
 
-        switch_logger()
+        self.for_each_problem(
+            lambda problem, pool: problem.verify(fail_fast=fail_fast,
+                                                 pool=pool),
+            jobs=jobs)
 
     def get_descriptor_path(self):
         """Return a path to contest's descriptor file."""
 
         return os.path.join(self.root, "contest.yaml")
 
-    def ejudge_export(self, language=None):
-        """Export problem in ejudge format to BUILD_ROOT/ejudge"""
+    def ejudge_export(self, language=None, jobs=1, pool=None):
+        """Export contest in ejudge format to BUILD_ROOT/ejudge.
+        Only changed files are written.
+
+        Args:
+            language: language of problems' names.
+            jobs: number of files to stage simultaneously.
+            pool: Pool to use instead of a new one.
+        """
 
         path = os.path.join(self.root, BUILD_DIR, "ejudge")
-        rmtree(path, ignore_errors=True)
-        ejudge_export(self, path, language=language)
+        ejudge_export(self, path, language=language, jobs=jobs, pool=pool)
 
 
 class ContestStatement(Statement):
@@ -164,6 +256,7 @@ class ContestStatement(Statement):
 
         return os.path.join(self.get_build_root(), "statements.log")
 
+    @traced("statements")
     def build(self):
         """Builds the statement."""
 
@@ -5,11 +5,8 @@
 
 using namespace std;
 
-int main(int argc, char * argv[])
+void check()
 {
-    setName("compare files as sequence of lines");
-    registerTestlibCmd(argc, argv);
-
     std::string strAnswer;
 
     int n = 0;
@@ -34,3 +31,9 @@ int main(int argc, char * argv[])
     
     quitf(_ok, "%d lines", n);
 }
+
+int main(int argc, char * argv[])
+{
+    setName("compare files as sequence of lines");
+    return runTestlibChecker(argc, argv, check);
+}
@@ -11,11 +11,8 @@ bool isNumeric(const string& p)
     return pnum.matches(p);
 }
 
-int main(int argc, char * argv[])
+void check()
 {
-    setName("compare two signed huge integers");
-    registerTestlibCmd(argc, argv);
-    
     string ja = ans.readWord();
     string pa = ouf.readWord();
 
@@ -33,3 +30,9 @@ int main(int argc, char * argv[])
     
     quitf(_ok, "answer is '%s'", compress(ja).c_str());
 }
+
+int main(int argc, char * argv[])
+{
+    setName("compare two signed huge integers");
+    return runTestlibChecker(argc, argv, check);
+}
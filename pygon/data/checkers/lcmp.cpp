@@ -23,11 +23,8 @@ bool compareWords(string a, string b)
     return (va == vb);
 }
 
-int main(int argc, char * argv[])
+void check()
 {
-    setName("compare files as sequence of tokens in lines");
-    registerTestlibCmd(argc, argv);
-
     std::string strAnswer;
 
     int n = 0;
@@ -52,3 +49,9 @@ int main(int argc, char * argv[])
     
     quitf(_ok, "%d lines", n);
 }
+
+int main(int argc, char * argv[])
+{
+    setName("compare files as sequence of tokens in lines");
+    return runTestlibChecker(argc, argv, check);
+}
@@ -3,46 +3,78 @@
 
 using namespace std;
 
-int main(int argc, char * argv[])
+/* Numbers are compared in blocks of this size. */
+const size_t BLOCK_SIZE = 1 << 12;
+
+long long jBlock[BLOCK_SIZE];
+long long pBlock[BLOCK_SIZE];
+
+/* Counts the remaining numbers in the stream. */
+int countRest(InStream& in)
 {
-    setName("compare ordered sequences of signed int%d numbers", 8 * int(sizeof(long long)));
+    int count = 0;
 
-    registerTestlibCmd(argc, argv);
+    while (!in.seekEof())
+    {
+        size_t k = in.readLongsUpTo(jBlock, BLOCK_SIZE);
+        if (k == 0)
+        {
+            in.readLong();
+            k = 1;
+        }
+        count += int(k);
+    }
 
+    return count;
+}
+
+void check()
+{
     int n = 0;
     string firstElems;
 
-    while (!ans.seekEof() && !ouf.seekEof())
+    int extraInAnsCount = 0;
+
+    while (extraInAnsCount == 0 && !ans.seekEof() && !ouf.seekEof())
     {
-        n++;
-        long long j = ans.readLong();
-        long long p = ouf.readLong();
-        if (j != p)
-            quitf(_wa, "%d%s numbers differ - expected: '%s', found: '%s'", n, englishEnding(n).c_str(), vtos(j).c_str(), vtos(p).c_str());
-        else
-            if (n <= 5)
+        size_t jCount = ans.readLongsUpTo(jBlock, BLOCK_SIZE);
+        if (jCount == 0)
+        {
+            jBlock[0] = ans.readLong();
+            jCount = 1;
+        }
+
+        size_t pCount = ouf.readLongsUpTo(pBlock, jCount);
+
+        for (size_t i = 0; i < jCount; i++)
+        {
+            if (i >= pCount)
             {
-                if (firstElems.length() > 0)
-                    firstElems += " ";
-                firstElems += vtos(j);
+                if (ouf.seekEof())
+                {
+                    extraInAnsCount = int(jCount - i);
+                    break;
+                }
+                pBlock[i] = ouf.readLong();
             }
-    }
-
-    int extraInAnsCount = 0;
 
-    while (!ans.seekEof())
-    {
-        ans.readLong();
-        extraInAnsCount++;
+            n++;
+            long long j = jBlock[i];
+            long long p = pBlock[i];
+            if (j != p)
+                quitf(_wa, "%d%s numbers differ - expected: '%s', found: '%s'", n, englishEnding(n).c_str(), vtos(j).c_str(), vtos(p).c_str());
+            else
+                if (n <= 5)
+                {
+                    if (firstElems.length() > 0)
+                        firstElems += " ";
+                    firstElems += vtos(j);
+                }
+        }
     }
-    
-    int extraInOufCount = 0;
 
-    while (!ouf.seekEof())
-    {
-        ouf.readLong();
-        extraInOufCount++;
-    }
+    extraInAnsCount += countRest(ans);
+    int extraInOufCount = countRest(ouf);
 
     if (extraInAnsCount > 0)
         quitf(_wa, "Answer contains longer sequence [length = %d], but output contains %d elements", n + extraInAnsCount, n);
@@ -55,3 +87,9 @@ int main(int argc, char * argv[])
     else
         quitf(_ok, "%d numbers", n);
 }
+
+int main(int argc, char * argv[])
+{
+    setName("compare ordered sequences of signed int%d numbers", 8 * int(sizeof(long long)));
+    return runTestlibChecker(argc, argv, check);
+}
@@ -0,0 +1,61 @@
+#include "testlib.h"
+
+using namespace std;
+
+const double EPS = 1E-6;
+
+/* Numbers are compared in blocks of this size. */
+const size_t BLOCK_SIZE = 1 << 12;
+
+double jBlock[BLOCK_SIZE];
+double pBlock[BLOCK_SIZE];
+
+void check()
+{
+    int n = 0;
+    double j = 0, p = 0;
+
+    while (!ans.seekEof())
+    {
+        size_t jCount = ans.readDoublesUpTo(jBlock, BLOCK_SIZE);
+        if (jCount == 0)
+        {
+            jBlock[0] = ans.readDouble();
+            jCount = 1;
+        }
+
+        /* The output is compared as it's read, so that the first difference is reported. */
+        size_t pCount = 0, k = 0;
+        while (k == pCount && pCount < jCount)
+        {
+            size_t count = ouf.readDoublesUpTo(pBlock + pCount, jCount - pCount);
+            if (count == 0)
+            {
+                pBlock[pCount] = ouf.readDouble();
+                count = 1;
+            }
+
+            k = pCount + doublesCompare(jBlock + pCount, pBlock + pCount, count, EPS);
+            pCount += count;
+        }
+
+        n += int(__testlib_min(k + 1, jCount));
+        j = jBlock[__testlib_min(k, jCount - 1)];
+        p = pBlock[__testlib_min(k, jCount - 1)];
+
+        if (k < jCount)
+            quitf(_wa, "%d%s numbers differ - expected: '%.6f', found: '%.6f', error = '%.6f'",
+                n, englishEnding(n).c_str(), j, p, doubleDelta(j, p));
+    }
+
+    if (n == 1)
+        quitf(_ok, "found '%.6f', expected '%.6f', error '%.6f'", p, j, doubleDelta(j, p));
+
+    quitf(_ok, "%d numbers", n);
+}
+
+int main(int argc, char * argv[])
+{
+    setName("compare two sequences of doubles, max absolute or relative error = %.6f", EPS);
+    return runTestlibChecker(argc, argv, check);
+}
@@ -6,11 +6,8 @@ using namespace std;
 const string YES = "YES";
 const string NO = "NO";
 
-int main(int argc, char * argv[])
+void check()
 {
-    setName("%s", (YES + " or " + NO + " (case insensetive)").c_str());
-    registerTestlibCmd(argc, argv);
-
     std::string ja = upperCase(ans.readWord());
     std::string pa = upperCase(ouf.readWord());
 
@@ -25,3 +22,9 @@ int main(int argc, char * argv[])
 
     quitf(_ok, "answer is %s", ja.c_str());
 }
+
+int main(int argc, char * argv[])
+{
+    setName("%s", (YES + " or " + NO + " (case insensetive)").c_str());
+    return runTestlibChecker(argc, argv, check);
+}
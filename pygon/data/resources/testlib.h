@@ -63,6 +63,15 @@
  */
 
 const char* latestFeatures[] = {
+                          "Allocation-free readDoublesUpTo and block comparison with doublesCompare (see rcmp6/rcmp9)",
+                          "Patterns given as strings are compiled once, char-sets are matched with tables",
+                          "Buffered output with its own number formatting: bout << value, bout.flush()",
+                          "Random generator version 2 (xoshiro256**), registerGen(argc, argv, 2), and rnd.fill/rnd.permutation",
+                          "Single-pass format validation with validateWellFormed (see wfval)",
+                          "Allocation-free readLongsTo/readIntsTo/readLongsUpTo and block comparison with skipEqualTokens",
+                          "Vectorized whitespace skipping and integer reading for in-memory data",
+                          "Regular files are memory-mapped instead of being read into buffers (not on Windows)",
+                          "Batch checker mode: runTestlibChecker(argc, argv, check) with \"--batch\" argument",
                           "Fixed stringstream repeated usage issue",
                           "Fixed compilation in g++ (for std=c++03)",
                           "Batch of println functions (support collections, iterator ranges)",
@@ -163,6 +172,15 @@ const char* latestFeatures[] = {
 #include <stdarg.h>
 #include <fcntl.h>
 
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define __TESTLIB_AVX2
+#   define __TESTLIB_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define __TESTLIB_SSE2
+#endif
+
 #if ( _WIN32 || __WIN32__ || _WIN64 || __WIN64__ || __CYGWIN__ )
 #   if !defined(_MSC_VER) || _MSC_VER>1400
 #       define NOMINMAX 1
@@ -181,6 +199,8 @@ const char* latestFeatures[] = {
 #else
 #   define WORD unsigned short
 #   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
 #endif
 
 #if defined(FOR_WINDOWS) && defined(FOR_LINUX)
@@ -444,6 +464,40 @@ inline double doubleDelta(double expected, double result)
         return absolute;
 }
 
+/*
+ * Compares count pairs of doubles as doubleCompare does. Returns the index
+ * of the first pair, which differs, or count if all of them are close.
+ * Pairs of ordinary values within the absolute error are accepted
+ * branch-free, block by block, the rest are passed to doubleCompare.
+ */
+inline size_t doublesCompare(const double* expected, const double* result, size_t count, double MAX_DOUBLE_ERROR)
+{
+    const size_t BLOCK_SIZE = 16;
+    const double error = MAX_DOUBLE_ERROR + 1E-15;
+
+    for (size_t i = 0; i < count; )
+    {
+        size_t end = __testlib_min(i + BLOCK_SIZE, count);
+        bool close = true;
+
+        /* NaNs fail every comparison, so they are never accepted here. */
+        for (size_t k = i; k < end; k++)
+            close &= (std::fabs(expected[k]) <= 1E300) & (std::fabs(result[k]) <= 1E300)
+                & (std::fabs(result[k] - expected[k]) <= error);
+
+        if (!close)
+        {
+            for (size_t k = i; k < end; k++)
+                if (!doubleCompare(expected[k], result[k], MAX_DOUBLE_ERROR))
+                    return k;
+        }
+
+        i = end;
+    }
+
+    return count;
+}
+
 #if !defined(_MSC_VER) || _MSC_VER<1900
 #ifndef _fileno
 #define _fileno(_stream)  ((_stream)->_file)
@@ -500,7 +554,9 @@ static void __testlib_set_binary(std::FILE* file)
  * If you want to use one expression many times it is better to compile it into
  * a single pattern like "pattern p("[a-z]+")". Later you can use 
  * "p.matches(std::string s)" or "p.next(random_t& rd)" to check matching or generate
- * new string by pattern.
+ * new string by pattern. Methods, which take a pattern as a string (like
+ * "inf.readToken("[a-z]+")" or "rnd.next("[a-z]+")"), compile each string once,
+ * see pattern::get().
  * 
  * Simpler way to read token and check it for pattern matching is "inf.readToken("[a-z]+")".
  */
@@ -517,14 +573,25 @@ public:
     bool matches(const std::string& s) const;
     /* Returns source string of the pattern. */
     std::string src() const;
+    /* Returns pattern for the string, which is constructed on the first call only. */
+    static const pattern& get(const std::string& s);
 private:
     bool matches(const std::string& s, size_t pos) const;
+    /* Number of characters of the char-set from pos on, at most "to". */
+    size_t greedyMatch(const std::string& s, size_t pos) const;
+    /* Builds table (and range) from chars. */
+    void compileChars();
 
     std::string s;
     std::vector<pattern> children;
     std::vector<char> chars;
     int from;
     int to;
+    /* Bit (c % 64) of table[c / 64] is set if (unsigned char)c is in chars. */
+    unsigned long long table[4];
+    /* If chars are exactly the codes rangeFirst..rangeLast, the range, else rangeFirst > rangeLast. */
+    int rangeFirst;
+    int rangeLast;
 };
 
 /* 
@@ -536,6 +603,11 @@ private:
  * Use registerGen(argc, argv, 1) to setup random_t seed be command
  * line (to use latest random generator version).
  *
+ * Version 2, registerGen(argc, argv, 2), uses a much faster engine
+ * (xoshiro256**) and doesn't divide to get values in a range, but its
+ * values differ from version 1 ones, so keep existing generators on 1
+ * for their tests to stay the same.
+ *
  * Random generates uniformly distributed values if another strategy is
  * not specified explicitly.
  */
@@ -548,8 +620,89 @@ private:
     static const unsigned long long mask;
     static const int lim;
 
+    /* State of xoshiro256** (version 2), derived from seed. */
+    unsigned long long state[4];
+
+    static unsigned long long rotl(unsigned long long x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    /* Fills the xoshiro256** state from seed with splitmix64. */
+    void expandSeed()
+    {
+        unsigned long long x = seed;
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            state[i] = z ^ (z >> 31);
+        }
+    }
+
+    /* Next 64 random bits of xoshiro256**. */
+    unsigned long long nextLong64()
+    {
+        unsigned long long result = rotl(state[1] * 5, 7) * 9;
+        unsigned long long t = state[1] << 17;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+
+        return result;
+    }
+
+    /* Sets high and low to the halves of the 128-bit product x * y. */
+    static void multiply(unsigned long long x, unsigned long long y,
+                         unsigned long long& high, unsigned long long& low)
+    {
+#ifdef __SIZEOF_INT128__
+        unsigned __int128 m = (unsigned __int128)(x) * y;
+        high = (unsigned long long)(m >> 64);
+        low = (unsigned long long)(m);
+#else
+        unsigned long long x0 = x & 0xFFFFFFFFULL, x1 = x >> 32;
+        unsigned long long y0 = y & 0xFFFFFFFFULL, y1 = y >> 32;
+        unsigned long long p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+        unsigned long long middle = (p00 >> 32) + (p01 & 0xFFFFFFFFULL) + (p10 & 0xFFFFFFFFULL);
+        high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+        low = (middle << 32) | (p00 & 0xFFFFFFFFULL);
+#endif
+    }
+
+    /*
+     * Random value in range [0, n-1] for version 2, n > 0. It uses
+     * multiplication instead of division (Lemire's method).
+     */
+    unsigned long long nextBounded(unsigned long long n)
+    {
+        unsigned long long high, low;
+        multiply(nextLong64(), n, high, low);
+
+        if (low < n)
+        {
+            unsigned long long threshold = (0ULL - n) % n;
+            while (low < threshold)
+                multiply(nextLong64(), n, high, low);
+        }
+
+        return high;
+    }
+
     long long nextBits(int bits) 
     {
+        if (random_t::version >= 2)
+        {
+            if (bits > 63)
+                __testlib_fail("random_t::nextBits(int bits): n must be less than 64");
+            return bits == 0 ? 0 : (long long)(nextLong64() >> (64 - bits));
+        }
+
         if (bits <= 48)
         {
             seed = (seed * multiplier + addend) & mask;
@@ -576,6 +729,7 @@ public:
     random_t()
         : seed(3905348978240129619LL)
     {
+        expandSeed();
     }
 
     /* Sets seed by command line. */
@@ -593,6 +747,7 @@ public:
         }
 
         seed = seed & mask;
+        expandSeed();
     }
 
     /* Sets seed by given value. */ 
@@ -600,21 +755,20 @@ public:
     {
         _seed = (_seed ^ multiplier) & mask;
         seed = _seed;
+        expandSeed();
     }
 
 #ifndef __BORLANDC__
     /* Random string value by given pattern (see pattern documentation). */
     std::string next(const std::string& ptrn)
     {
-        pattern p(ptrn);
-        return p.next(*this);
+        return pattern::get(ptrn).next(*this);
     }
 #else
     /* Random string value by given pattern (see pattern documentation). */
     std::string next(std::string ptrn)
     {
-        pattern p(ptrn);
-        return p.next(*this);
+        return pattern::get(ptrn).next(*this);
     }
 #endif
 
@@ -624,6 +778,9 @@ public:
         if (n <= 0)
             __testlib_fail("random_t::next(int n): n must be positive");
 
+        if (random_t::version >= 2)
+            return int(nextBounded((unsigned long long)(n)));
+
         if ((n & -n) == n)  // n is a power of 2
             return (int)((n * (long long)nextBits(31)) >> 31);
 
@@ -651,6 +808,9 @@ public:
         if (n <= 0)
             __testlib_fail("random_t::next(long long n): n must be positive");
 
+        if (random_t::version >= 2)
+            return (long long)(nextBounded((unsigned long long)(n)));
+
         const long long limit = __TESTLIB_LONGLONG_MAX / n * n;
         
         long long bits;
@@ -726,6 +886,9 @@ public:
     /* Random double value in range [0, 1). */
     double next() 
     {
+        if (random_t::version >= 2)
+            return (double)(nextLong64() >> 11) / (double)(1LL << 53);
+
         long long left = ((long long)(nextBits(26)) << 27);
         long long right = nextBits(27);
         return (double)(left + right) / (double)(1LL << 53);
@@ -745,6 +908,44 @@ public:
         return next(to - from) + from;
     }
 
+    /*
+     * Fills [first, last) with random values in range [from, to],
+     * the same as assigning next(from, to) to each element in order.
+     */
+    template <typename Iterator, typename T>
+    void fill(Iterator first, Iterator last, T from, T to)
+    {
+        for (; first != last; ++first)
+            *first = next(from, to);
+    }
+
+    /* Fills the vector with random values in range [from, to], see fill(first, last, from, to). */
+    template <typename T, typename U>
+    void fill(std::vector<T>& v, U from, U to)
+    {
+        for (typename std::vector<T>::iterator i = v.begin(); i != v.end(); ++i)
+            *i = T(next(from, to));
+    }
+
+    /*
+     * Returns random permutation of first, first + 1, ..., first + n - 1.
+     * It's the same as shuffling them with shuffle().
+     */
+    std::vector<int> permutation(int n, int first = 0)
+    {
+        if (n < 0)
+            __testlib_fail("random_t::permutation(int n, int first): n must be non-negative");
+
+        std::vector<int> result(n);
+        for (int i = 0; i < n; i++)
+            result[i] = first + i;
+
+        for (int i = 1; i < n; i++)
+            std::swap(result[i], result[next(i + 1)]);
+
+        return result;
+    }
+
     /* Returns random element from container. */
     template <typename Container>
     typename Container::value_type any(const Container& c)
@@ -1076,23 +1277,52 @@ static char __pattern_getChar(const std::string& s, size_t& pos)
     return s[pos - 1];
 }
 
+static inline int __testlib_ctz(unsigned int x)
+{
 #ifdef __GNUC__
-__attribute__((pure))
+    return __builtin_ctz(x);
+#else
+    int res = 0;
+    while (!(x & 1u))
+        x >>= 1, res++;
+    return res;
+#endif
+}
+
+static inline int __testlib_popcount(unsigned int x)
+{
+#ifdef __GNUC__
+    return __builtin_popcount(x);
+#else
+    int res = 0;
+    for (; x; x &= x - 1)
+        res++;
+    return res;
 #endif
-static int __pattern_greedyMatch(const std::string& s, size_t pos, const std::vector<char> chars)
+}
+
+/* Returns the number of leading characters of s[0..n) with codes first..last. */
+static inline size_t __pattern_countRange(const char* s, size_t n, int first, int last)
 {
-    int result = 0;
+    size_t i = 0;
 
-    while (pos < s.length())
+#ifdef __TESTLIB_SSE2
+    /* Shifted by (128 - first), the range becomes -128..(last - first - 128) as signed chars. */
+    __m128i shift = _mm_set1_epi8(char(128 - first));
+    __m128i bound = _mm_set1_epi8(char(last - first - 128 + 1));
+    for (; i + 16 <= n; i += 16)
     {
-        char c = s[pos++];
-        if (!std::binary_search(chars.begin(), chars.end(), c))
-            break;
-        else
-            result++;
+        __m128i b = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(s + i)), shift);
+        unsigned int other = ~(unsigned int)(_mm_movemask_epi8(_mm_cmplt_epi8(b, bound))) & 0xFFFFu;
+        if (other)
+            return i + __testlib_ctz(other);
     }
+#endif
 
-    return result;
+    for (; i < n && int((unsigned char)(s[i])) >= first && int((unsigned char)(s[i])) <= last; i++)
+        ;
+
+    return i;
 }
 
 std::string pattern::src() const
@@ -1100,17 +1330,73 @@ std::string pattern::src() const
     return s;
 }
 
-bool pattern::matches(const std::string& s, size_t pos) const
+const pattern& pattern::get(const std::string& s)
 {
-    std::string result;
+    static std::map<std::string, pattern> patterns;
+
+    std::map<std::string, pattern>::iterator i = patterns.find(s);
+    if (i == patterns.end())
+        i = patterns.insert(std::make_pair(s, pattern(s))).first;
+
+    return i->second;
+}
+
+void pattern::compileChars()
+{
+    table[0] = table[1] = table[2] = table[3] = 0;
+    for (size_t i = 0; i < chars.size(); i++)
+    {
+        int code = int((unsigned char)(chars[i]));
+        table[code / 64] |= 1ULL << (code % 64);
+    }
 
+    rangeFirst = 1;
+    rangeLast = 0;
+    if (!chars.empty())
+    {
+        int first = 256, last = -1;
+        for (size_t i = 0; i < chars.size(); i++)
+        {
+            first = __testlib_min(first, int((unsigned char)(chars[i])));
+            last = __testlib_max(last, int((unsigned char)(chars[i])));
+        }
+
+        /* Chars may repeat (e.g. "[aac]"), so check every char of the range. */
+        bool range = true;
+        for (int code = first; code <= last && range; code++)
+            range = (table[code / 64] >> (code % 64)) & 1;
+
+        if (range)
+            rangeFirst = first, rangeLast = last;
+    }
+}
+
+size_t pattern::greedyMatch(const std::string& s, size_t pos) const
+{
+    size_t limit = __testlib_min(s.length() - pos, size_t(to));
+
+    if (rangeFirst <= rangeLast)
+        return __pattern_countRange(s.data() + pos, limit, rangeFirst, rangeLast);
+
+    size_t result = 0;
+    while (result < limit)
+    {
+        int code = int((unsigned char)(s[pos + result]));
+        if (!((table[code / 64] >> (code % 64)) & 1))
+            break;
+        result++;
+    }
+
+    return result;
+}
+
+bool pattern::matches(const std::string& s, size_t pos) const
+{
     if (to > 0)
     {
-        int size = __pattern_greedyMatch(s, pos, chars);
-        if (size < from)
+        size_t size = greedyMatch(s, pos);
+        if (size < size_t(from))
             return false;
-        if (size > to)
-            size = to;
         pos += size;
     }
 
@@ -1366,6 +1652,8 @@ pattern::pattern(std::string s): s(s), from(0), to(0)
                 children.push_back(pattern(s.substr(pos)));
         }
     }
+
+    compileChars();
 }
 /* End of pattern implementation */
 
@@ -1449,6 +1737,25 @@ public:
     virtual void close() = 0;
     virtual int getLine() = 0;
     virtual ~InputStreamReader() = 0;
+
+    /*
+     * Readers keeping the data in memory return a pointer to the current
+     * character and set available to the number of characters starting from it,
+     * so that the data can be scanned directly. Others return NULL.
+     */
+    virtual const char* view(size_t& available)
+    {
+        available = 0;
+        return NULL;
+    }
+
+    /* Skips count characters, returned by view(); lines of them are LFs. */
+    virtual void skipViewed(size_t count, int lines)
+    {
+        (void)lines;
+        for (size_t i = 0; i < count; i++)
+            skipChar();
+    }
 };
 
 InputStreamReader::~InputStreamReader()
@@ -1647,6 +1954,9 @@ private:
     std::string name;
     int line;
 
+    /* Buffers of closed readers, reused by new readers (e.g. in batch mode). */
+    static std::vector<std::pair<char*, bool*> > spareBuffers;
+
     bool refill()
     {
         if (NULL == file)
@@ -1686,14 +1996,29 @@ private:
 public:
     BufferedFileInputStreamReader(std::FILE* file, const std::string& name): file(file), name(name), line(1)
     {
-        buffer = new char[BUFFER_SIZE];
-        isEof = new bool[BUFFER_SIZE];
+        if (!spareBuffers.empty())
+        {
+            buffer = spareBuffers.back().first;
+            isEof = spareBuffers.back().second;
+            spareBuffers.pop_back();
+        }
+        else
+        {
+            buffer = new char[BUFFER_SIZE];
+            isEof = new bool[BUFFER_SIZE];
+        }
         bufferSize = MAX_UNREAD_COUNT;
         bufferPos = int(MAX_UNREAD_COUNT);
     }
 
     ~BufferedFileInputStreamReader()
     {
+        if (NULL != buffer && NULL != isEof && spareBuffers.size() < 3)
+        {
+            spareBuffers.push_back(std::make_pair(buffer, isEof));
+            buffer = NULL;
+            isEof = NULL;
+        }
         if (NULL != buffer)
         {
             delete[] buffer;
@@ -1753,18 +2078,524 @@ public:
         return !refill() || EOFC == curChar();
     }
 
-    void close()
+    void close()
+    {
+        if (NULL != file)
+        {
+            fclose(file);
+            file = NULL;
+        }
+    }
+};
+
+#ifndef ON_WINDOWS
+/*
+ * Reads a regular file (or standard input redirected from a regular file),
+ * mapped into memory, without copying it.
+ * The mapping is private, so unreadChar may change the data in place.
+ */
+class MmapFileInputStreamReader: public InputStreamReader
+{
+private:
+    std::FILE* file;
+    char* data;
+    size_t size;
+    size_t pos;
+
+    std::string name;
+    int line;
+
+    /*
+     * Standard streams mimic FileInputStreamReader: characters are unsigned
+     * (so byte 255 reads as EOFC) and the end of file, once reached, is final.
+     * Other files mimic BufferedFileInputStreamReader.
+     */
+    bool stdfile;
+    bool eofReached;
+
+    MmapFileInputStreamReader(std::FILE* file, char* data, size_t size, size_t pos,
+                              const std::string& name, bool stdfile):
+        file(file), data(data), size(size), pos(pos), name(name), line(1),
+        stdfile(stdfile), eofReached(false)
+    {
+        // No operations.
+    }
+
+    /* Checks for the end of data, remembering it for standard streams. */
+    bool atEnd()
+    {
+        if (pos >= size)
+        {
+            if (stdfile)
+                eofReached = true;
+            return true;
+        }
+
+        return eofReached;
+    }
+
+    int at(size_t i)
+    {
+        return stdfile ? int((unsigned char)data[i]) : int(data[i]);
+    }
+
+public:
+    /* Returns NULL if the file can't be mapped (e.g. it is a pipe). */
+    static MmapFileInputStreamReader* open(std::FILE* file, const std::string& name, bool stdfile)
+    {
+        struct stat st;
+        if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode))
+            return NULL;
+
+        // Standard input may be already partially read.
+        off_t offset = lseek(fileno(file), 0, SEEK_CUR);
+        if (offset < 0 || offset > st.st_size || ftell(file) != offset)
+            return NULL;
+
+        size_t size = size_t(st.st_size);
+        char* data = NULL;
+
+        if (size > 0)
+        {
+            void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+            if (MAP_FAILED == mapped)
+                return NULL;
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = (char*)mapped;
+        }
+
+        return new MmapFileInputStreamReader(file, data, size, size_t(offset), name, stdfile);
+    }
+
+    ~MmapFileInputStreamReader()
+    {
+        close();
+    }
+
+    int curChar()
+    {
+        return atEnd() ? EOFC : at(pos);
+    }
+
+    int nextChar()
+    {
+        if (atEnd())
+        {
+            if (!stdfile)
+                pos++;
+            return EOFC;
+        }
+
+        int c = at(pos++);
+        if (c == LF)
+            line++;
+        return c;
+    }
+
+    void skipChar()
+    {
+        if (stdfile && eofReached)
+            return;
+        if (pos < size && data[pos] == LF)
+            line++;
+        pos++;
+    }
+
+    void unreadChar(int c)
+    {
+        if (c == LF)
+            line--;
+        if (stdfile && eofReached)
+            return;
+        if (pos == 0)
+            __testlib_fail("MmapFileInputStreamReader::unreadChar(int): pos == 0.");
+        pos--;
+        if (pos < size && c != EOFC && data[pos] != char(c))
+            data[pos] = char(c);
+    }
+
+    std::string getName()
+    {
+        return name;
+    }
+
+    int getLine()
+    {
+        return line;
+    }
+
+    bool eof()
+    {
+        if (atEnd())
+            return true;
+
+        // FileInputStreamReader consumes the EOFC-like character.
+        if (stdfile && at(pos) == EOFC)
+        {
+            pos++;
+            return true;
+        }
+
+        return false;
+    }
+
+    const char* view(size_t& available)
+    {
+        if (atEnd())
+        {
+            available = 0;
+            return NULL;
+        }
+
+        available = size - pos;
+        return data + pos;
+    }
+
+    void skipViewed(size_t count, int lines)
+    {
+        pos += count;
+        line += lines;
+    }
+
+    void close()
+    {
+        if (NULL != data)
+        {
+            munmap(data, size);
+            data = NULL;
+            size = pos = 0;
+        }
+        if (NULL != file)
+        {
+            fclose(file);
+            file = NULL;
+        }
+    }
+};
+#endif
+
+const size_t BufferedFileInputStreamReader::BUFFER_SIZE = 2000000;
+const size_t BufferedFileInputStreamReader::MAX_UNREAD_COUNT = BufferedFileInputStreamReader::BUFFER_SIZE / 2; 
+std::vector<std::pair<char*, bool*> > BufferedFileInputStreamReader::spareBuffers;
+
+/*
+ * Returns the number of leading blanks (see isBlanks) in s[0..n)
+ * and adds the number of LFs among them to lines.
+ */
+static inline size_t __testlib_countBlanks(const char* s, size_t n, int& lines)
+{
+    size_t i = 0;
+
+#ifdef __TESTLIB_AVX2
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i lf = _mm256_cmpeq_epi8(b, _mm256_set1_epi8(LF));
+        __m256i blank = _mm256_or_si256(
+            _mm256_or_si256(lf, _mm256_cmpeq_epi8(b, _mm256_set1_epi8(CR))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8(SPACE)),
+                            _mm256_cmpeq_epi8(b, _mm256_set1_epi8(TAB))));
+        unsigned int other = ~(unsigned int)(_mm256_movemask_epi8(blank));
+        unsigned int lfs = (unsigned int)(_mm256_movemask_epi8(lf));
+        if (other)
+        {
+            int k = __testlib_ctz(other);
+            lines += __testlib_popcount(lfs & ((1u << k) - 1u));
+            return i + k;
+        }
+        lines += __testlib_popcount(lfs);
+    }
+#endif
+
+#ifdef __TESTLIB_SSE2
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i lf = _mm_cmpeq_epi8(b, _mm_set1_epi8(LF));
+        __m128i blank = _mm_or_si128(
+            _mm_or_si128(lf, _mm_cmpeq_epi8(b, _mm_set1_epi8(CR))),
+            _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(SPACE)),
+                         _mm_cmpeq_epi8(b, _mm_set1_epi8(TAB))));
+        unsigned int other = ~(unsigned int)(_mm_movemask_epi8(blank)) & 0xFFFFu;
+        unsigned int lfs = (unsigned int)(_mm_movemask_epi8(lf));
+        if (other)
+        {
+            int k = __testlib_ctz(other);
+            lines += __testlib_popcount(lfs & ((1u << k) - 1u));
+            return i + k;
+        }
+        lines += __testlib_popcount(lfs);
+    }
+#endif
+
+    for (; i < n && isBlanks(s[i]); i++)
+        if (s[i] == LF)
+            lines++;
+
+    return i;
+}
+
+/* Returns the number of leading decimal digits in s[0..n). */
+static inline size_t __testlib_countDigits(const char* s, size_t n)
+{
+    size_t i = 0;
+
+    /* Digits are exactly the bytes, for which (c - '0' - 128) is less than -118. */
+#ifdef __TESTLIB_AVX2
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i b = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(s + i)),
+                                    _mm256_set1_epi8(char('0' + 128)));
+        __m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(-118), b);
+        unsigned int other = ~(unsigned int)(_mm256_movemask_epi8(digit));
+        if (other)
+            return i + __testlib_ctz(other);
+    }
+#endif
+
+#ifdef __TESTLIB_SSE2
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i b = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(s + i)),
+                                 _mm_set1_epi8(char('0' + 128)));
+        __m128i digit = _mm_cmplt_epi8(b, _mm_set1_epi8(-118));
+        unsigned int other = ~(unsigned int)(_mm_movemask_epi8(digit)) & 0xFFFFu;
+        if (other)
+            return i + __testlib_ctz(other);
+    }
+#endif
+
+    for (; i < n && s[i] >= '0' && s[i] <= '9'; i++)
+        ;
+
+    return i;
+}
+
+/* Returns the length of the common prefix of a[0..n) and b[0..n). */
+static inline size_t __testlib_commonPrefix(const char* a, const char* b, size_t n)
+{
+    size_t i = 0;
+
+#ifdef __TESTLIB_AVX2
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                       _mm256_loadu_si256((const __m256i*)(b + i)));
+        unsigned int diff = ~(unsigned int)(_mm256_movemask_epi8(eq));
+        if (diff)
+            return i + __testlib_ctz(diff);
+    }
+#endif
+
+#ifdef __TESTLIB_SSE2
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                    _mm_loadu_si128((const __m128i*)(b + i)));
+        unsigned int diff = ~(unsigned int)(_mm_movemask_epi8(eq)) & 0xFFFFu;
+        if (diff)
+            return i + __testlib_ctz(diff);
+    }
+#endif
+
+    for (; i < n && a[i] == b[i]; i++)
+        ;
+
+    return i;
+}
+
+/* Returns the number of leading characters with codes 33..127 in s[0..n). */
+static inline size_t __testlib_countVisible(const char* s, size_t n)
+{
+    size_t i = 0;
+
+    /* As signed chars, these are exactly the ones greater than 32. */
+#ifdef __TESTLIB_AVX2
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i visible = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(s + i)),
+                                            _mm256_set1_epi8(32));
+        unsigned int other = ~(unsigned int)(_mm256_movemask_epi8(visible));
+        if (other)
+            return i + __testlib_ctz(other);
+    }
+#endif
+
+#ifdef __TESTLIB_SSE2
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i visible = _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)(s + i)),
+                                         _mm_set1_epi8(32));
+        unsigned int other = ~(unsigned int)(_mm_movemask_epi8(visible)) & 0xFFFFu;
+        if (other)
+            return i + __testlib_ctz(other);
+    }
+#endif
+
+    for (; i < n && (signed char)(s[i]) > 32; i++)
+        ;
+
+    return i;
+}
+
+/*
+ * Checks that s[0..n) is a well-formed text (see InStream::validateWellFormed).
+ * Lines end as the strict "InStream::eoln()" expects: with CR LF on Windows,
+ * with LF elsewhere; any other CR or LF is an illegal character.
+ * Returns NULL, or an error message and its 1-based position.
+ */
+static inline const char* __testlib_checkWellFormed(const char* s, size_t n, int& line, size_t& column, int& code)
+{
+    line = 1;
+    column = 1;
+    code = 0;
+
+    if (n == 0)
+        return "empty input";
+
+    size_t lineBegin = 0;
+
+    for (size_t i = 0; ; i++)
+    {
+        i += __testlib_countVisible(s + i, n - i);
+        column = i - lineBegin + 1;
+
+        if (i == n)
+            break;
+
+        /* Length of the line terminator at i, if there is one. */
+#if (defined(ON_WINDOWS) && !defined(FOR_LINUX)) || defined(FOR_WINDOWS)
+        size_t eoln = (s[i] == CR && i + 1 < n && s[i + 1] == LF) ? 2 : 0;
+#else
+        size_t eoln = (s[i] == LF) ? 1 : 0;
+#endif
+
+        if (s[i] == ' ')
+        {
+            if (i == lineBegin || s[i - 1] == ' ')
+                return "illegal space";
+        }
+        else if (eoln > 0)
+        {
+            if (i == lineBegin && line == 1)
+                return "illegal leading empty line";
+            if (i > lineBegin && s[i - 1] == ' ')
+                return "illegal trailing space";
+            if (i + eoln == n && i == lineBegin)
+                return "illegal trailing empty line";
+            line++;
+            i += eoln - 1;
+            lineBegin = i + 1;
+        }
+        else
+        {
+            code = (int)(signed char)(s[i]);
+            return "illegal character with code %d";
+        }
+    }
+
+    if (lineBegin != n)
+    {
+        if (s[n - 1] == ' ')
+            return "illegal trailing space";
+        return "last line doesn't end with eoln";
+    }
+
+    return NULL;
+}
+
+/*
+ * Tries to read a decimal integer of at most maxDigits digits, which is
+ * followed by a blank or the end of data, straight from the reader's memory.
+ * In any other case (including malformed or huge integers) returns false
+ * and leaves the reader untouched, so that the caller falls back to
+ * the generic path with all its checks and messages.
+ */
+static inline bool __testlib_tryReadInteger(InputStreamReader* reader, size_t maxDigits, long long& value)
+{
+    size_t n;
+    const char* s = reader->view(n);
+
+    if (NULL == s)
+        return false;
+
+    size_t begin = (s[0] == '-') ? 1 : 0;
+    size_t digits = __testlib_countDigits(s + begin, n - begin);
+
+    if (digits == 0 || digits > maxDigits)
+        return false;
+
+    /* Leading zeroes and negative zero are not allowed. */
+    if (s[begin] == '0' && (digits > 1 || begin > 0))
+        return false;
+
+    size_t end = begin + digits;
+
+    if (end < n && !isBlanks(s[end]))
+        return false;
+
+    long long result = 0;
+    for (size_t i = begin; i < end; i++)
+        result = result * 10 + (s[i] - '0');
+
+    value = begin > 0 ? -result : result;
+    reader->skipViewed(end, 0);
+    return true;
+}
+
+/*
+ * Tries to read a decimal like "-12.345" (digits, optionally followed by
+ * a point and digits) straight from the reader's memory, as
+ * __testlib_tryReadInteger does. The digits without the point should make
+ * an integer below 2^53, and there should be at most 22 digits after
+ * the point: then both the integer and the power of ten are exact doubles,
+ * and their quotient is correctly rounded, i.e. equals the value of sscanf.
+ */
+static inline bool __testlib_tryReadDouble(InputStreamReader* reader, double& value)
+{
+    static const double powers[] = {
+        1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11,
+        1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+    };
+
+    size_t n;
+    const char* s = reader->view(n);
+
+    if (NULL == s)
+        return false;
+
+    size_t begin = (s[0] == '-') ? 1 : 0;
+    size_t digits = __testlib_countDigits(s + begin, n - begin);
+    size_t end = begin + digits;
+    size_t fractionDigits = 0;
+
+    if (digits == 0)
+        return false;
+
+    if (end < n && s[end] == '.')
     {
-        if (NULL != file)
-        {
-            fclose(file);
-            file = NULL;
-        }
+        fractionDigits = __testlib_countDigits(s + end + 1, n - end - 1);
+        if (fractionDigits == 0 || fractionDigits > 22)
+            return false;
+        end += 1 + fractionDigits;
     }
-};
 
-const size_t BufferedFileInputStreamReader::BUFFER_SIZE = 2000000;
-const size_t BufferedFileInputStreamReader::MAX_UNREAD_COUNT = BufferedFileInputStreamReader::BUFFER_SIZE / 2; 
+    if (digits + fractionDigits > 19 || (end < n && !isBlanks(s[end])))
+        return false;
+
+    unsigned long long mantissa = 0;
+    for (size_t i = begin; i < end; i++)
+        if (s[i] != '.')
+            mantissa = mantissa * 10 + (s[i] - '0');
+
+    if (mantissa > (1ULL << 53))
+        return false;
+
+    double result = double(mantissa) / powers[fractionDigits];
+    value = begin > 0 ? -result : result;
+    reader->skipViewed(end, 0);
+    return true;
+}
 
 /*
  * Streams to be used for reading data in checkers or validators.
@@ -1900,6 +2731,51 @@ struct InStream
     /* Reads space-separated sequence of integers. */
     std::vector<int> readInts(int size, int minv, int maxv, const std::string& variablesName = "", int indexBase = 1);
 
+    /*
+     * As "readLongs()" and "readInts()", but store the integers to [first, last)
+     * instead of allocating a vector.
+     */
+    template <typename Iterator>
+    void readLongsTo(Iterator first, Iterator last, long long minv, long long maxv, const std::string& variablesName = "", int indexBase = 1);
+    template <typename Iterator>
+    void readIntsTo(Iterator first, Iterator last, int minv, int maxv, const std::string& variablesName = "", int indexBase = 1);
+
+    /*
+     * Reads at most count integers into buffer and returns the number of read ones.
+     * Stops early at the end of file or before a token, which is not a plain
+     * int64 of at most 18 digits: read it with "readLong()" to get the usual
+     * checks and messages. Never fails. Returns 0 in the strict mode.
+     */
+    size_t readLongsUpTo(long long* buffer, size_t count);
+
+    /*
+     * As "readLongsUpTo()", but for doubles. Stops before a token, which is
+     * not a plain decimal like "-12.345", whose digits make an integer below
+     * 2^53, with at most 22 digits after the point: read it with
+     * "readDouble()" to get the usual checks and messages.
+     */
+    size_t readDoublesUpTo(double* buffer, size_t count);
+
+    /*
+     * Skips equal tokens in this and other stream, comparing their data in
+     * blocks, as long as the white-spaces between them are equal, too.
+     * Stops before the first token, which may differ, or may not be read with
+     * "readWordTo()" without an error. Sets lastToken to the last skipped token.
+     * Returns the number of skipped tokens. Returns 0 in the strict mode.
+     */
+    size_t skipEqualTokens(InStream& other, std::string& lastToken);
+
+    /*
+     * Reads the rest of the stream and checks that it's a well-formed text:
+     * it's not empty, contains only line ends and characters with codes
+     * 32..127, every line ends with eoln (CR LF on Windows, LF elsewhere,
+     * as "eoln()" expects), there are no leading, trailing or double
+     * spaces in lines, and no leading or trailing empty lines.
+     * Fails with the position of the first violation otherwise.
+     * In-memory data is checked in a single pass.
+     */
+    void validateWellFormed();
+
     /* 
      * Reads new double. Ignores white-spaces into the non-strict mode 
      * (strict mode is used in validators usually). 
@@ -2246,6 +3122,199 @@ void disableFinalizeGuard()
  */
 std::fstream tout;
 
+/*
+ * Buffered output, which formats numbers itself instead of printf/iostreams,
+ * so that generators write large tests at disk speed. Testlib defines global
+ * variable "bout", writing to stdout: "bout << n << '\n';".
+ *
+ * The data is written only when the buffer is full, on flush() and at exit,
+ * so don't mix it with other ways of writing to the same file. Interactors
+ * must call flush() after each message to the solution:
+ * "bout << answer << '\n'; bout.flush();".
+ */
+class BufferedOutput
+{
+public:
+    explicit BufferedOutput(std::FILE* file = stdout, size_t capacity = 1 << 16):
+        file(file), capacity(capacity), size(0), precision(6)
+    {
+        // The buffer is allocated on the first write.
+    }
+
+    ~BufferedOutput()
+    {
+        flush();
+    }
+
+    /* Writes count characters of data. */
+    BufferedOutput& write(const char* data, size_t count)
+    {
+        if (size + count > buffer.size())
+        {
+            flushBuffer();
+            if (count >= capacity)
+            {
+                std::fwrite(data, 1, count, file);
+                return *this;
+            }
+            buffer.resize(capacity);
+        }
+
+        std::memcpy(&buffer[size], data, count);
+        size += count;
+        return *this;
+    }
+
+    /* Writes the buffered data to the file and flushes it. */
+    void flush()
+    {
+        flushBuffer();
+        std::fflush(file);
+    }
+
+    /* Sets the number of digits after the decimal point for doubles (6 by default). */
+    void setPrecision(int digits)
+    {
+        precision = digits;
+    }
+
+    /*
+     * Writes value with digits after the decimal point, like "%.*f".
+     * Values halfway between two results (up to the rounding error of scaling)
+     * are rounded away from zero, so the last digit may differ from printf.
+     */
+    BufferedOutput& writeDouble(double value, int digits)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+        double magnitude = value < 0 ? -value : value;
+
+        if (digits < 0 || digits > 9 || !(magnitude * powers[digits] < 9e18))
+            return *this << format("%.*f", __testlib_max(digits, 0), value);
+
+        unsigned long long scaled = (unsigned long long)(magnitude * powers[digits] + 0.5);
+        unsigned long long scale = (unsigned long long)(powers[digits]);
+
+        if (value < 0)
+            *this << '-';
+
+        *this << scaled / scale;
+
+        if (digits > 0)
+        {
+            char temp[16];
+            unsigned long long fraction = scaled % scale;
+            temp[0] = '.';
+            for (int i = digits; i > 0; i--, fraction /= 10)
+                temp[i] = char('0' + fraction % 10);
+            write(temp, size_t(digits) + 1);
+        }
+
+        return *this;
+    }
+
+    /* Writes elements of [first, last), separated by separator. */
+    template <typename Iterator>
+    BufferedOutput& writeMany(Iterator first, Iterator last, char separator = ' ')
+    {
+        for (Iterator i = first; i != last; ++i)
+        {
+            if (i != first)
+                *this << separator;
+            *this << *i;
+        }
+        return *this;
+    }
+
+    BufferedOutput& operator<<(char c)
+    {
+        if (size == buffer.size())
+            write(&c, 1);
+        else
+            buffer[size++] = c;
+        return *this;
+    }
+
+    BufferedOutput& operator<<(const char* s)
+    {
+        return write(s, std::strlen(s));
+    }
+
+    BufferedOutput& operator<<(const std::string& s)
+    {
+        return write(s.data(), s.size());
+    }
+
+    BufferedOutput& operator<<(unsigned long long value)
+    {
+        char temp[24];
+        char* end = temp + sizeof(temp);
+        char* begin = end;
+
+        do {
+            *--begin = char('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+
+        return write(begin, size_t(end - begin));
+    }
+
+    BufferedOutput& operator<<(long long value)
+    {
+        if (value < 0)
+        {
+            *this << '-';
+            return *this << (0ULL - (unsigned long long)(value));
+        }
+        return *this << (unsigned long long)(value);
+    }
+
+    BufferedOutput& operator<<(int value)
+    {
+        return *this << (long long)(value);
+    }
+
+    BufferedOutput& operator<<(unsigned int value)
+    {
+        return *this << (unsigned long long)(value);
+    }
+
+    BufferedOutput& operator<<(long value)
+    {
+        return *this << (long long)(value);
+    }
+
+    BufferedOutput& operator<<(unsigned long value)
+    {
+        return *this << (unsigned long long)(value);
+    }
+
+    /* Writes the value with the precision set by setPrecision(). */
+    BufferedOutput& operator<<(double value)
+    {
+        return writeDouble(value, precision);
+    }
+
+private:
+    BufferedOutput(const BufferedOutput&);
+    BufferedOutput& operator=(const BufferedOutput&);
+
+    void flushBuffer()
+    {
+        if (size > 0)
+            std::fwrite(&buffer[0], 1, size, file);
+        size = 0;
+    }
+
+    std::FILE* file;
+    size_t capacity;
+    std::vector<char> buffer;
+    size_t size;
+    int precision;
+};
+
+BufferedOutput bout;
+
 /* implementation
  */
 
@@ -2412,8 +3481,27 @@ void InStream::textColor(
 #endif
 }
 
+/*
+ * In batch mode (see runTestlibChecker) quit doesn't terminate the process,
+ * but throws __testlib_batch_exit with the exit code instead.
+ */
+struct __testlib_batch_exit
+{
+    int exitCode;
+
+    explicit __testlib_batch_exit(int exitCode): exitCode(exitCode)
+    {
+    }
+};
+
+bool __testlib_batchMode = false;
+std::string __testlib_batchMessage;
+
 NORETURN void halt(int exitCode)
 {
+    if (__testlib_batchMode)
+        throw __testlib_batch_exit(exitCode);
+
 #ifdef FOOTER
     InStream::textColor(InStream::LightGray);
     std::fprintf(stderr, "Checker: \"%s\"\n", checkerName.c_str());
@@ -2541,6 +3629,9 @@ NORETURN void InStream::quit(TResult result, const char* msg)
             quit(_fail, "Can not write to the result file");
     }
 
+    if (__testlib_batchMode)
+        __testlib_batchMessage = errorName + msg;
+
     quitscr(LightGray, msg);
     std::fprintf(stderr, "\n");
 
@@ -2645,10 +3736,17 @@ void InStream::reset(std::FILE* file)
 
         __testlib_set_binary(file);
 
-        if (stdfile)
-            reader = new FileInputStreamReader(file, name);
-        else
-            reader = new BufferedFileInputStreamReader(file, name);
+        reader = NULL;
+#ifndef ON_WINDOWS
+        reader = MmapFileInputStreamReader::open(file, name, stdfile);
+#endif
+        if (NULL == reader)
+        {
+            if (stdfile)
+                reader = new FileInputStreamReader(file, name);
+            else
+                reader = new BufferedFileInputStreamReader(file, name);
+        }
     }
     else
     {
@@ -2745,6 +3843,18 @@ void InStream::skipChar()
 
 void InStream::skipBlanks()
 {
+    size_t available;
+    const char* data;
+
+    while (NULL != (data = reader->view(available)))
+    {
+        int lines = 0;
+        size_t blanks = __testlib_countBlanks(data, available, lines);
+        reader->skipViewed(blanks, lines);
+        if (blanks < available)
+            return;
+    }
+
     while (isBlanks(reader->curChar()))
         reader->skipChar();
 }
@@ -2857,12 +3967,12 @@ std::vector<std::string> InStream::readWords(int size, const pattern& p, const s
 
 std::string InStream::readWord(const std::string& ptrn, const std::string& variableName)
 {
-    return readWord(pattern(ptrn), variableName);
+    return readWord(pattern::get(ptrn), variableName);
 }
 
 std::vector<std::string> InStream::readWords(int size, const std::string& ptrn, const std::string& variablesName, int indexBase)
 {
-    pattern p(ptrn);
+    const pattern& p = pattern::get(ptrn);
     __testlib_readMany(readWords, readWord(p, variablesName), std::string, true);
 }
 
@@ -2883,7 +3993,7 @@ std::string InStream::readToken(const std::string& ptrn, const std::string& vari
 
 std::vector<std::string> InStream::readTokens(int size, const std::string& ptrn, const std::string& variablesName, int indexBase)
 {
-    pattern p(ptrn);
+    const pattern& p = pattern::get(ptrn);
     __testlib_readMany(readTokens, readWord(p, variablesName), std::string, true);
 }
 
@@ -2901,7 +4011,7 @@ void InStream::readWordTo(std::string& result, const pattern& p, const std::stri
 
 void InStream::readWordTo(std::string& result, const std::string& ptrn, const std::string& variableName)
 {
-    return readWordTo(result, pattern(ptrn), variableName);
+    return readWordTo(result, pattern::get(ptrn), variableName);
 }
 
 void InStream::readTokenTo(std::string& result, const pattern& p, const std::string& variableName)
@@ -3190,6 +4300,12 @@ int InStream::readInteger()
     if (!strict && seekEof())
         quit(_unexpected_eof, "Unexpected end of file - int32 expected");
 
+    /* Integers of at most 9 digits always fit into int32. */
+    long long fast;
+    lastLine = reader->getLine();
+    if (__testlib_tryReadInteger(reader, 9, fast))
+        return int(fast);
+
     readWordTo(_tmpReadToken);
     
     long long value = stringToLongLong(*this, _tmpReadToken.c_str());
@@ -3204,6 +4320,12 @@ long long InStream::readLong()
     if (!strict && seekEof())
         quit(_unexpected_eof, "Unexpected end of file - int64 expected");
 
+    /* Integers of at most 18 digits always fit into int64. */
+    long long fast;
+    lastLine = reader->getLine();
+    if (__testlib_tryReadInteger(reader, 18, fast))
+        return fast;
+
     readWordTo(_tmpReadToken);
 
     return stringToLongLong(*this, _tmpReadToken.c_str());
@@ -3338,12 +4460,179 @@ std::vector<int> InStream::readIntegers(int size, int minv, int maxv, const std:
     __testlib_readMany(readIntegers, readInt(minv, maxv, variablesName), int, true)
 }
 
+template <typename Iterator>
+void InStream::readLongsTo(Iterator first, Iterator last, long long minv, long long maxv, const std::string& variablesName, int indexBase)
+{
+    readManyIteration = indexBase;
+
+    for (Iterator i = first; i != last; )
+    {
+        *i = readLong(minv, maxv, variablesName);
+        readManyIteration++;
+        if (++i != last && strict)
+            readSpace();
+    }
+
+    readManyIteration = NO_INDEX;
+}
+
+template <typename Iterator>
+void InStream::readIntsTo(Iterator first, Iterator last, int minv, int maxv, const std::string& variablesName, int indexBase)
+{
+    readManyIteration = indexBase;
+
+    for (Iterator i = first; i != last; )
+    {
+        *i = readInt(minv, maxv, variablesName);
+        readManyIteration++;
+        if (++i != last && strict)
+            readSpace();
+    }
+
+    readManyIteration = NO_INDEX;
+}
+
+size_t InStream::readLongsUpTo(long long* buffer, size_t count)
+{
+    if (strict || NULL == reader)
+        return 0;
+
+    size_t result = 0;
+
+    while (result < count)
+    {
+        skipBlanks();
+        if (!__testlib_tryReadInteger(reader, 18, buffer[result]))
+            break;
+        result++;
+    }
+
+    return result;
+}
+
+size_t InStream::readDoublesUpTo(double* buffer, size_t count)
+{
+    if (strict || NULL == reader)
+        return 0;
+
+    size_t result = 0;
+
+    while (result < count)
+    {
+        skipBlanks();
+        if (!__testlib_tryReadDouble(reader, buffer[result]))
+            break;
+        result++;
+    }
+
+    return result;
+}
+
+size_t InStream::skipEqualTokens(InStream& other, std::string& lastToken)
+{
+    if (strict || other.strict || NULL == reader || NULL == other.reader)
+        return 0;
+
+    size_t result = 0;
+    size_t maxLength = std::min(maxTokenLength, other.maxTokenLength);
+
+    while (true)
+    {
+        skipBlanks();
+        other.skipBlanks();
+
+        size_t available, otherAvailable;
+        const char* data = reader->view(available);
+        const char* otherData = other.reader->view(otherAvailable);
+
+        if (NULL == data || NULL == otherData)
+            break;
+
+        size_t common = __testlib_commonPrefix(data, otherData, std::min(available, otherAvailable));
+        bool bothEnd = (common == available && common == otherAvailable);
+
+        /* A token is complete, if it is followed by a common blank or both data end. */
+        size_t tokens = 0, end = 0, lastBegin = 0;
+
+        for (size_t i = 0; i < common; )
+        {
+            size_t begin = i;
+
+            /* Byte 255 may be EOFC for some readers, leave it to the generic path. */
+            while (i < common && !isBlanks(data[i]) && (unsigned char)(data[i]) != 255)
+                i++;
+
+            if ((i == common && !bothEnd) || (i < common && !isBlanks(data[i])) || i - begin > maxLength)
+                break;
+
+            tokens++;
+            lastBegin = begin;
+            end = i;
+
+            int ignored = 0;
+            i += __testlib_countBlanks(data + i, common - i, ignored);
+        }
+
+        if (tokens == 0)
+            break;
+
+        lastToken.assign(data + lastBegin, end - lastBegin);
+
+        int lines = int(std::count(data, data + end, LF));
+        reader->skipViewed(end, lines);
+        other.reader->skipViewed(end, lines);
+        result += tokens;
+    }
+
+    return result;
+}
+
+void InStream::validateWellFormed()
+{
+    std::string buffer;
+    size_t size = 0;
+    const char* data = NULL;
+
+    if (NULL != reader)
+        data = reader->view(size);
+
+    if (NULL == data)
+    {
+        while (!eof())
+            buffer += readChar();
+        data = buffer.c_str();
+        size = buffer.size();
+    }
+
+    int line, code;
+    size_t column;
+    const char* error = __testlib_checkWellFormed(data, size, line, column, code);
+
+    if (NULL != error)
+    {
+        std::string message = format(error, code);
+        if (size > 0)
+            message += format(" (line %d, column %d)", line, int(column));
+        quit(_fail, message.c_str());
+    }
+
+    if (buffer.empty() && size > 0)
+        reader->skipViewed(size, line - 1);
+}
+
 double InStream::readReal()
 {
     if (!strict && seekEof())
         quit(_unexpected_eof, "Unexpected end of file - double expected");
 
-    return stringToDouble(*this, readWord().c_str());
+    double fast;
+    lastLine = reader->getLine();
+    if (__testlib_tryReadDouble(reader, fast))
+        return fast;
+
+    readWordTo(_tmpReadToken);
+
+    return stringToDouble(*this, _tmpReadToken.c_str());
 }
 
 double InStream::readDouble()
@@ -3641,7 +4930,7 @@ void InStream::readStringTo(std::string& result, const pattern& p, const std::st
 
 void InStream::readStringTo(std::string& result, const std::string& ptrn, const std::string& variableName)
 {
-    readStringTo(result, pattern(ptrn), variableName);
+    readStringTo(result, pattern::get(ptrn), variableName);
 }
 
 std::string InStream::readString(const pattern& p, const std::string& variableName)
@@ -3663,7 +4952,7 @@ std::string InStream::readString(const std::string& ptrn, const std::string& var
 
 std::vector<std::string> InStream::readStrings(int size, const std::string& ptrn, const std::string& variablesName, int indexBase)
 {
-    pattern p(ptrn);
+    const pattern& p = pattern::get(ptrn);
     __testlib_readMany(readStrings, readString(p, variablesName), std::string, false)
 }
 
@@ -3709,7 +4998,7 @@ std::string InStream::readLine(const std::string& ptrn, const std::string& varia
 
 std::vector<std::string> InStream::readLines(int size, const std::string& ptrn, const std::string& variablesName, int indexBase)
 {
-    pattern p(ptrn);
+    const pattern& p = pattern::get(ptrn);
     __testlib_readMany(readLines, readString(p, variablesName), std::string, false)
 }
 
@@ -3877,8 +5166,8 @@ static void __testlib_ensuresPreconditions()
 
 void registerGen(int argc, char* argv[], int randomGeneratorVersion)
 {
-    if (randomGeneratorVersion < 0 || randomGeneratorVersion > 1)
-        quitf(_fail, "Random generator version is expected to be 0 or 1.");
+    if (randomGeneratorVersion < 0 || randomGeneratorVersion > 2)
+        quitf(_fail, "Random generator version is expected to be 0, 1 or 2.");
     random_t::version = randomGeneratorVersion;
 
     __testlib_ensuresPreconditions();
@@ -4085,6 +5374,82 @@ void registerTestlibCmd(int argc, char* argv[])
     ans.init(argv[3], _answer);
 }
 
+static bool __testlib_readBatchField(std::string& field)
+{
+    field.clear();
+
+    int c;
+    while ((c = std::getchar()) != EOF && c != 0)
+        field += char(c);
+
+    return c == 0;
+}
+
+/*
+ * Runs checker check(), which must end with quit or quitf call.
+ *
+ * Usually works like registerTestlibCmd(argc, argv) followed by check().
+ *
+ * If the only argument is "--batch", checks many tests in the same process:
+ * reads NUL-terminated triples <input-file> <output-file> <answer-file> from
+ * stdin and writes a line "<exit code> <message>" to stdout for each of them.
+ * check() must not depend on global state, changed by previous runs.
+ */
+int runTestlibChecker(int argc, char* argv[], void (*check)())
+{
+    if (argc != 2 || strcmp("--batch", argv[1]))
+    {
+        registerTestlibCmd(argc, argv);
+        check();
+        return 0;
+    }
+
+    __testlib_ensuresPreconditions();
+
+    testlibMode = _checker;
+    __testlib_set_binary(stdin);
+
+    resultName = "";
+    appesMode = false;
+    __testlib_batchMode = true;
+
+    std::string input, output, answer;
+
+    while (__testlib_readBatchField(input)
+            && __testlib_readBatchField(output)
+            && __testlib_readBatchField(answer))
+    {
+        int exitCode;
+
+        __testlib_batchMessage.clear();
+
+        try
+        {
+            inf.init(input, _input);
+            ouf.init(output, _output);
+            ans.init(answer, _answer);
+            check();
+            quit(_fail, "Checker must end with quit or quitf call.");
+        }
+        catch (const __testlib_batch_exit& e)
+        {
+            exitCode = e.exitCode;
+        }
+
+        for (size_t i = 0; i < __testlib_batchMessage.length(); i++)
+            if (__testlib_batchMessage[i] == LF || __testlib_batchMessage[i] == CR)
+                __testlib_batchMessage[i] = ' ';
+
+        std::fprintf(stdout, "%d %s\n", exitCode, __testlib_batchMessage.c_str());
+        std::fflush(stdout);
+    }
+
+    __testlib_batchMode = false;
+    TestlibFinalizeGuard::alive = false;
+
+    return 0;
+}
+
 void registerTestlib(int argc, ...)
 {
     if (argc  < 3 || argc > 5)
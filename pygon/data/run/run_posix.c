@@ -20,35 +20,134 @@
 // SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <poll.h>
+#include <time.h>
+#include <dirent.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
 #define OK 0
 #define TL 1
 #define ML 2
 #define RL 3
+#define OL 4
+
+// How often limits are checked when running in a cgroup
+// or interactively, in milliseconds.
+#define TICK 5
+
+// An interactive run is stopped if both processes are sleeping
+// without using CPU time for this long, in milliseconds.
+#define IDLE 250
+
+// Hardware counters, collected with -p option.
+#define COUNTERS 3
 
 typedef struct {
     int verdict;
     int exitcode;
     int time;
     int memory;
+    // Values of hardware counters, or -1 if not collected.
+    long long counters[COUNTERS];
 } result_t;
 
+// Resource usage of a process, sampled every TICK milliseconds with -t
+// option. The trace file consists of TRACE_MAGIC followed by samples
+// as they are in memory (native byte order, no padding).
+#define TRACE_MAGIC "PYGTRC01"
+
+typedef struct {
+    // Real time since the start, in milliseconds.
+    uint32_t time;
+    // CPU time, in milliseconds.
+    uint32_t cpu;
+    // Resident set size, in KiB.
+    uint32_t rss;
+    // State of the process (e.g. 'R', 'S' or 'D').
+    uint32_t state;
+    // Bytes read and written by the process (including pipes).
+    uint64_t rchar;
+    uint64_t wchar;
+} sample_t;
+
 static char *verdicts[] = {
     "ERR",
     "OK",
     "TL",
     "ML",
-    "RL"
+    "RL",
+    "OL"
 };
 
+typedef struct {
+    int cpu;
+    const char *cgroup;
+    int perf;
+    // File to write the trace of the (solution) process to, or NULL.
+    const char *trace;
+} options_t;
+
+typedef struct {
+    int argc;
+    char **argv;
+    int tl;
+    int ml;
+    int rl;
+    // Output limit in MiB (applies to every file the process writes),
+    // or 0 if not limited.
+    int ol;
+    const char *cwd;
+    const char *input;
+    const char *output;
+    const char *error;
+    // Descriptors to use as stdin and stdout instead of files, or -1.
+    int in;
+    int out;
+} job_t;
+
+// A started process of a job.
+typedef struct {
+    const job_t *job;
+    result_t *res;
+    int pid;
+    int pidfd;
+    int use_cgroup;
+    // Set if the cgroup limits memory (otherwise RLIMIT_AS does).
+    int cgroup_memory;
+    int running;
+    // Set if the process was killed because the other process
+    // of an interactive run has already decided the verdict.
+    int killed;
+    int st;
+    struct rusage ru;
+    // When the process was started (wall clock).
+    time_t started;
+    char cg[PATH_MAX];
+    int perf[COUNTERS];
+    // Trace file of the process, or NULL.
+    FILE *trace;
+} proc_t;
+
 static result_t *res;
 static int pid;
 
@@ -58,61 +157,652 @@ static void onalarm(int sig)
     kill(pid, SIGKILL);
 }
 
-void run(int argc, char **argv, int tl, int ml, int rl, result_t *r)
+static int write_file(const char *dir, const char *name, const char *value)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    int fd = open(path, O_WRONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int len = strlen(value);
+    int ok = write(fd, value, len) == len;
+    close(fd);
+
+    return ok ? 0 : -1;
+}
+
+// Reads a number from a file. If key is not NULL, the file is expected
+// to consist of "<key> <value>" lines (like cpu.stat). Returns -1 on error.
+static long long read_file(const char *dir, const char *name, const char *key)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return -1;
+    }
+
+    long long res = -1;
+    char buf[256];
+    long long value;
+
+    while (fscanf(f, "%255s", buf) == 1) {
+        if (!key) {
+            res = atoll(buf);
+            break;
+        }
+
+        if (fscanf(f, "%lld", &value) != 1) {
+            break;
+        }
+
+        if (!strcmp(buf, key)) {
+            res = value;
+            break;
+        }
+    }
+
+    fclose(f);
+
+    return res;
+}
+
+static long long now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void pin(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+static int redirect(const char *path, int fd, int flags)
+{
+    int f = open(path, flags, 0666);
+
+    if (f < 0) {
+        return -1;
+    }
+
+    if (f != fd) {
+        dup2(f, fd);
+        close(f);
+    }
+
+    return 0;
+}
+
+// Creates a cgroup for a single run inside opt->cgroup.
+// Returns 0 on success, cg is set to cgroup's path, limited is set
+// if the cgroup's memory limit has been set.
+static int cgroup_create(const options_t *opt, const job_t *job, char *cg,
+                         int *limited)
+{
+    static int counter;
+
+    snprintf(cg, PATH_MAX, "%s/run-%d-%d", opt->cgroup, (int)getpid(), counter++);
+
+    if (mkdir(cg, 0755) < 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", (long long)job->ml * 1024 * 1024);
+    *limited = write_file(cg, "memory.max", buf) == 0;
+    write_file(cg, "memory.swap.max", "0");
+
+    return 0;
+}
+
+static void cgroup_kill(const char *cg)
+{
+    write_file(cg, "cgroup.kill", "1");
+}
+
+static void cgroup_destroy(const char *cg)
+{
+    cgroup_kill(cg);
+
+    // Killed processes may take a while to leave the cgroup.
+    for (int i = 0; i < 100 && rmdir(cg) < 0 && errno == EBUSY; ++i) {
+        usleep(1000);
+    }
+}
+
+// Reads state and CPU time (in milliseconds) of a process
+// from /proc. Returns -1 if not available.
+static int read_stat(int pid, char *state, long long *usage)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return -1;
+    }
+
+    char buf[1024];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = 0;
+
+    // The command name may contain anything, so skip to the last ')'.
+    char *p = strrchr(buf, ')');
+    unsigned long long utime, stime;
+
+    if (!p || sscanf(p + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u"
+                     " %llu %llu", state, &utime, &stime) != 3) {
+        return -1;
+    }
+
+    *usage = (utime + stime) * 1000 / sysconf(_SC_CLK_TCK);
+
+    return 0;
+}
+
+// Writes a sample of the process's resource usage to its trace.
+static void trace_sample(proc_t *p, long long elapsed)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", p->pid);
+
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return;
+    }
+
+    char buf[1024];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = 0;
+
+    char *s = strrchr(buf, ')');
+    char state;
+    unsigned long long utime, stime;
+    long long rss;
+
+    if (!s || sscanf(s + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u"
+                     " %llu %llu %*d %*d %*d %*d %*d %*d %*u %*u %lld",
+                     &state, &utime, &stime, &rss) != 4) {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d", p->pid);
+
+    sample_t sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.time = elapsed;
+    sample.cpu = (utime + stime) * 1000 / sysconf(_SC_CLK_TCK);
+    sample.rss = rss * (sysconf(_SC_PAGESIZE) / 1024);
+    sample.state = state;
+
+    long long rchar = read_file(path, "io", "rchar:");
+    long long wchar = read_file(path, "io", "wchar:");
+    sample.rchar = rchar > 0 ? rchar : 0;
+    sample.wchar = wchar > 0 ? wchar : 0;
+
+    fwrite(&sample, sizeof(sample), 1, p->trace);
+}
+
+// Opens hardware counters (instructions, cycles, cache misses)
+// for a process, which start counting once it calls exec.
+static void perf_open(proc_t *p)
+{
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    static const unsigned long long configs[COUNTERS] = {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+
+    for (int i = 0; i < COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        p->perf[i] = syscall(SYS_perf_event_open, &attr, p->pid, -1, -1,
+                             PERF_FLAG_FD_CLOEXEC);
+    }
+#endif
+}
+
+static void perf_read(proc_t *p)
+{
+    for (int i = 0; i < COUNTERS; ++i) {
+        long long value;
+
+        if (p->perf[i] >= 0) {
+            if (read(p->perf[i], &value, sizeof(value)) == sizeof(value)) {
+                p->res->counters[i] = value;
+            }
+            close(p->perf[i]);
+        }
+    }
+}
+
+static void set_cloexec(int fd)
+{
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+// Starts a process of a job. Returns 0 on success.
+static int proc_start(proc_t *p, const job_t *job, const options_t *opt,
+                      result_t *r)
 {
+    int tl = job->tl;
+    int ml = job->ml;
+
+    p->job = job;
+    p->res = r;
+    p->pidfd = -1;
+    p->running = 0;
+    p->killed = 0;
+    p->trace = NULL;
+    p->started = time(NULL);
+
     res = r;
     res->verdict = -1;
     res->exitcode = 0;
     res->time = 0;
     res->memory = 0;
 
-    pid = fork();
+    for (int i = 0; i < COUNTERS; ++i) {
+        p->perf[i] = -1;
+        res->counters[i] = -1;
+    }
 
-    if (pid < 0) {
-        return;
+    p->cgroup_memory = 0;
+    p->use_cgroup = opt->cgroup &&
+        cgroup_create(opt, job, p->cg, &p->cgroup_memory) == 0;
+
+    // The child waits until it's moved into the cgroup before exec.
+    // The parent sends 'm' if the memory is to be limited by RLIMIT_AS
+    // (i.e. the cgroup doesn't limit it), 'x' otherwise.
+    int sync[2];
+
+    if (pipe(sync) < 0) {
+        return -1;
     }
 
-    if (pid == 0) {
+    p->pid = fork();
+
+    if (p->pid < 0) {
+        close(sync[0]);
+        close(sync[1]);
+        return -1;
+    }
+
+    if (p->pid == 0) {
+        close(sync[1]);
+
+        char c;
+        if (read(sync[0], &c, 1) != 1) {
+            _exit(124);
+        }
+        close(sync[0]);
+
+        int limit_memory = c == 'm';
+
+        if (opt->cpu >= 0) {
+            pin(opt->cpu);
+        }
+
+        if (job->cwd && chdir(job->cwd) < 0) {
+            _exit(124);
+        }
+
+        if (job->in >= 0) {
+            dup2(job->in, 0);
+        } else if (job->input && redirect(job->input, 0, O_RDONLY) < 0) {
+            _exit(124);
+        }
+
+        if (job->out >= 0) {
+            dup2(job->out, 1);
+        } else if (job->output && redirect(job->output, 1,
+                                           O_WRONLY | O_CREAT | O_TRUNC) < 0) {
+            _exit(124);
+        }
+
+        if (job->error && redirect(job->error, 2,
+                                   O_WRONLY | O_CREAT | O_TRUNC) < 0) {
+            _exit(124);
+        }
+
         int sec = (tl + 999) / 1000;
         struct rlimit rlim;
         rlim.rlim_cur = sec;
         rlim.rlim_max = RLIM_INFINITY;
         setrlimit(RLIMIT_CPU, &rlim);
 
-        rlim.rlim_cur = (long)ml * 1024 * 1024 * 2;
-        rlim.rlim_max = (long)ml * 1024 * 1024 * 2;
-        setrlimit(RLIMIT_AS, &rlim);
+        if (limit_memory) {
+            rlim.rlim_cur = (long)ml * 1024 * 1024 * 2;
+            rlim.rlim_max = (long)ml * 1024 * 1024 * 2;
+            setrlimit(RLIMIT_AS, &rlim);
+        }
+
+        if (job->ol > 0) {
+            rlim.rlim_cur = (long)job->ol * 1024 * 1024;
+            rlim.rlim_max = (long)job->ol * 1024 * 1024;
+            setrlimit(RLIMIT_FSIZE, &rlim);
+            signal(SIGXFSZ, SIG_DFL);
+        }
 
-        execvp(argv[0], argv);
-        exit(124);
+        execvp(job->argv[0], job->argv);
+        _exit(124);
     }
 
-    signal(SIGALRM, onalarm);
-    alarm((rl + 999) / 1000);
+    close(sync[0]);
 
-    int st;
-    struct rusage ru;
+    if (opt->perf) {
+        perf_open(p);
+    }
 
-    wait4(pid, &st, 0, &ru);
+    if (p->use_cgroup) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%d", p->pid);
+        if (write_file(p->cg, "cgroup.procs", buf) < 0) {
+            cgroup_destroy(p->cg);
+            p->use_cgroup = 0;
+        }
+    }
 
-    res->time =  ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000;
-    res->time += ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000;
-    res->memory = ru.ru_maxrss / 1024;
+    int limit_memory = !p->use_cgroup || !p->cgroup_memory;
 
-    if (res->verdict == -1) {
-        if (WIFEXITED(st)) {
-            res->exitcode = WEXITSTATUS(st);
-        } else if (WIFSIGNALED(st)) {
-            int sig = WTERMSIG(st);
+    if (write(sync[1], limit_memory ? "m" : "x", 1) != 1) {
+        kill(p->pid, SIGKILL);
+    }
+    close(sync[1]);
+
+    p->running = 1;
+
+#ifdef SYS_pidfd_open
+    p->pidfd = syscall(SYS_pidfd_open, p->pid, 0);
+#endif
+
+    return 0;
+}
+
+static void proc_kill(proc_t *p, int verdict)
+{
+    if (p->res->verdict == -1) {
+        p->res->verdict = verdict;
+    }
+
+    if (p->use_cgroup) {
+        cgroup_kill(p->cg);
+    }
+
+    kill(p->pid, SIGKILL);
+}
+
+// Returns CPU time (in milliseconds) used by a running process so far,
+// or -1 if it's unknown. state is set to its state (e.g. 'S' if
+// sleeping), or to 0 if it's unknown.
+static long long proc_usage(const proc_t *p, char *state)
+{
+    long long usage = -1;
+
+    *state = 0;
+
+    if (read_stat(p->pid, state, &usage) < 0) {
+        *state = 0;
+        usage = -1;
+    }
+
+    if (p->use_cgroup) {
+        usage = read_file(p->cg, "cpu.stat", "usage_usec");
+        if (usage >= 0) {
+            usage /= 1000;
+        }
+    }
+
+    return usage;
+}
+
+// Waits for processes, checking their CPU time and real time every TICK
+// milliseconds. If n == 2, the processes are a solution and an interactor:
+// once one of them gets a verdict, which decides the outcome, the other
+// one is killed, and both are killed if they are idle (waiting for each
+// other) for IDLE milliseconds.
+static void proc_wait(proc_t *procs, int n)
+{
+    long long start = now();
+    long long idle_since = start;
+    long long idle_usage = -1;
+
+    for (;;) {
+        int running = 0;
+
+        for (int i = 0; i < n; ++i) {
+            proc_t *p = &procs[i];
+
+            if (p->running && wait4(p->pid, &p->st, WNOHANG, &p->ru) == p->pid) {
+                p->running = 0;
+            }
+
+            running += p->running;
+        }
+
+        if (n == 2) {
+            proc_t *sol = &procs[0];
+            proc_t *inter = &procs[1];
+
+            // The solution was stopped by a limit: its verdict is final.
+            if (!sol->running && sol->res->verdict != -1 && inter->running) {
+                inter->killed = 1;
+                proc_kill(inter, -1);
+            }
+
+            // The interactor has failed or rejected the solution.
+            if (!inter->running && sol->running &&
+                (inter->res->verdict != -1 || !WIFEXITED(inter->st) ||
+                 WEXITSTATUS(inter->st) != 0)) {
+                sol->killed = 1;
+                proc_kill(sol, -1);
+            }
+        }
+
+        if (!running) {
+            break;
+        }
+
+        long long t = now();
+        long long elapsed = t - start;
+        long long total = 0;
+        int idle = n == 2 && running == 2;
+
+        for (int i = 0; i < n; ++i) {
+            proc_t *p = &procs[i];
+
+            if (!p->running || p->res->verdict != -1) {
+                idle = 0;
+                continue;
+            }
+
+            char state;
+            long long usage = proc_usage(p, &state);
+
+            if (p->trace) {
+                trace_sample(p, elapsed);
+            }
+
+            if (elapsed >= p->job->rl) {
+                proc_kill(p, RL);
+            } else if (usage >= p->job->tl) {
+                proc_kill(p, TL);
+            }
+
+            total += usage;
+            idle = idle && state == 'S' && usage >= 0;
+        }
+
+        if (!idle || total != idle_usage) {
+            idle_since = t;
+            idle_usage = total;
+        } else if (t - idle_since >= IDLE) {
+            for (int i = 0; i < n; ++i) {
+                proc_kill(&procs[i], RL);
+            }
+        }
+
+        int timeout = TICK;
+        struct pollfd pfd[2];
+        int npfd = 0;
+
+        for (int i = 0; i < n; ++i) {
+            if (procs[i].running) {
+                if (procs[i].pidfd < 0) {
+                    npfd = -1;
+                    break;
+                }
+                pfd[npfd].fd = procs[i].pidfd;
+                pfd[npfd].events = POLLIN;
+                ++npfd;
+            }
+        }
+
+        if (npfd > 0) {
+            poll(pfd, npfd, timeout);
+        } else {
+            usleep(timeout * 1000);
+        }
+    }
+}
+
+// Checks if the process has written as much as its output limit
+// to stdout (it may have ignored SIGXFSZ and failed to write more).
+static int output_exceeded(const proc_t *p)
+{
+    const job_t *job = p->job;
+    struct stat st;
+
+    if (job->ol <= 0 || job->out >= 0) {
+        return 0;
+    }
+
+    if (job->output ? stat(job->output, &st) < 0 : fstat(1, &st) < 0) {
+        return 0;
+    }
+
+    return S_ISREG(st.st_mode) && st.st_size >= (long long)job->ol * 1024 * 1024;
+}
+
+// Checks if a file in the working directory of the process, written since
+// it was started, has grown to its output limit. A process, which the
+// command has started (e.g. by a shell wrapper), may have got SIGXFSZ
+// writing there, making the command just exit with an error.
+static int files_exceeded(const proc_t *p)
+{
+    const job_t *job = p->job;
+
+    if (job->ol <= 0) {
+        return 0;
+    }
+
+    DIR *dir = opendir(job->cwd ? job->cwd : ".");
+
+    if (!dir) {
+        return 0;
+    }
+
+    int fd = dirfd(dir);
+    int res = 0;
+    struct dirent *ent;
+    struct stat st;
+
+    while (!res && (ent = readdir(dir))) {
+        res = fstatat(fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+            S_ISREG(st.st_mode) && st.st_mtime >= p->started &&
+            st.st_size >= (long long)job->ol * 1024 * 1024;
+    }
+
+    closedir(dir);
+    return res;
+}
+
+// Computes the result of a finished process.
+static void proc_finish(proc_t *p)
+{
+    result_t *res = p->res;
+    int tl = p->job->tl;
+    int ml = p->job->ml;
+    struct rusage *ru = &p->ru;
+
+    if (p->pidfd >= 0) {
+        close(p->pidfd);
+    }
+
+    perf_read(p);
+
+    res->time =  ru->ru_utime.tv_sec * 1000 + ru->ru_utime.tv_usec / 1000;
+    res->time += ru->ru_stime.tv_sec * 1000 + ru->ru_stime.tv_usec / 1000;
+    res->memory = ru->ru_maxrss / 1024;
+
+    if (p->use_cgroup) {
+        long long usage = read_file(p->cg, "cpu.stat", "usage_usec");
+        long long peak = read_file(p->cg, "memory.peak", NULL);
+
+        if (usage >= 0) {
+            res->time = usage / 1000;
+        }
+
+        if (peak >= 0) {
+            res->memory = peak / 1024 / 1024;
+        }
+
+        if (res->verdict == -1 && read_file(p->cg, "memory.events", "oom_kill") > 0) {
+            res->verdict = ML;
+        }
+
+        cgroup_destroy(p->cg);
+    }
+
+    // SIGKILL sent to a process because of the other one's verdict
+    // doesn't mean the process has failed.
+    int ignore = p->killed && WIFSIGNALED(p->st) && WTERMSIG(p->st) == SIGKILL;
+
+    if (res->verdict == -1 && !ignore) {
+        if (WIFEXITED(p->st)) {
+            res->exitcode = WEXITSTATUS(p->st);
+        } else if (WIFSIGNALED(p->st)) {
+            int sig = WTERMSIG(p->st);
             if (sig == SIGXCPU) {
                 res->verdict = TL;
+            } else if (sig == SIGXFSZ) {
+                res->verdict = OL;
             }
             res->exitcode = -sig;
         }
     }
 
     if (res->verdict == -1) {
-        if (res->time >= tl) {
+        if (output_exceeded(p) || (res->exitcode != 0 && files_exceeded(p))) {
+            res->verdict = OL;
+        } else if (res->time >= tl) {
             res->verdict = TL;
         } else if (res->memory >= ml) {
             res->verdict = ML;
@@ -124,26 +814,405 @@ void run(int argc, char **argv, int tl, int ml, int rl, result_t *r)
     }
 }
 
+// Opens the trace of a started process, if it's requested.
+static void trace_open(proc_t *p, const options_t *opt)
+{
+    if (opt->trace && (p->trace = fopen(opt->trace, "wb"))) {
+        fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), p->trace);
+    }
+}
+
+static void trace_close(proc_t *p)
+{
+    if (p->trace) {
+        fclose(p->trace);
+        p->trace = NULL;
+    }
+}
+
+void run(const job_t *job, const options_t *opt, result_t *r)
+{
+    proc_t p;
+
+    if (proc_start(&p, job, opt, r) < 0) {
+        return;
+    }
+
+    trace_open(&p, opt);
+
+    // Traced processes are sampled while waiting for them.
+    if (p.use_cgroup || p.trace) {
+        proc_wait(&p, 1);
+    } else {
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        timer.it_value.tv_sec = job->rl / 1000;
+        timer.it_value.tv_usec = job->rl % 1000 * 1000;
+
+        pid = p.pid;
+        signal(SIGALRM, onalarm);
+        setitimer(ITIMER_REAL, &timer, NULL);
+
+        wait4(p.pid, &p.st, 0, &p.ru);
+
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_REAL, &timer, NULL);
+    }
+
+    trace_close(&p);
+    proc_finish(&p);
+}
+
+// Runs a solution (job) and an interactor (ijob), connecting stdout
+// of each one to stdin of the other.
+void interact(const job_t *job, const job_t *ijob, const options_t *opt,
+              result_t *r, result_t *ir)
+{
+    job_t sol = *job;
+    job_t inter = *ijob;
+    int to_inter[2], to_sol[2];
+
+    r->verdict = -1;
+    ir->verdict = -1;
+
+    if (pipe(to_inter) < 0) {
+        return;
+    }
+
+    if (pipe(to_sol) < 0) {
+        close(to_inter[0]);
+        close(to_inter[1]);
+        return;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        set_cloexec(to_inter[i]);
+        set_cloexec(to_sol[i]);
+    }
+
+    sol.in = to_sol[0];
+    sol.out = to_inter[1];
+    inter.in = to_inter[0];
+    inter.out = to_sol[1];
+
+    proc_t procs[2];
+    int started = 0;
+
+    if (proc_start(&procs[0], &sol, opt, r) == 0) {
+        ++started;
+        trace_open(&procs[0], opt);
+        if (proc_start(&procs[1], &inter, opt, ir) == 0) {
+            ++started;
+        } else {
+            proc_kill(&procs[0], -1);
+            procs[0].killed = 1;
+        }
+    }
+
+    // Only the processes hold the pipes now, so that closing
+    // them on exit is seen by the other side.
+    for (int i = 0; i < 2; ++i) {
+        close(to_inter[i]);
+        close(to_sol[i]);
+    }
+
+    proc_wait(procs, started);
+
+    for (int i = 0; i < started; ++i) {
+        trace_close(&procs[i]);
+        proc_finish(&procs[i]);
+    }
+
+    // The interactor failed to start.
+    if (started == 1) {
+        r->verdict = -1;
+    }
+}
+
+static char *read_field(void)
+{
+    char *buf = NULL;
+    size_t cap = 0;
+
+    if (getdelim(&buf, &cap, 0, stdin) < 0) {
+        free(buf);
+        return NULL;
+    }
+
+    return buf;
+}
+
+typedef struct {
+    job_t job;
+    char *head[8];
+    int nhead;
+} request_t;
+
+static void free_job(request_t *req)
+{
+    for (int i = 0; i < req->job.argc; ++i) {
+        free(req->job.argv[i]);
+    }
+    free(req->job.argv);
+
+    for (int i = 0; i < req->nhead; ++i) {
+        free(req->head[i]);
+    }
+
+    req->job.argc = 0;
+    req->job.argv = NULL;
+    req->nhead = 0;
+}
+
+// Reads a job from stdin: <nhead> header fields (the last one is <argc>),
+// followed by <argc> fields of arguments. If first is not NULL, it's
+// the first header field, which was already read (it's owned by req
+// from now on). Returns 0 on success. On failure everything read
+// (including first) is freed.
+static int read_job(request_t *req, int nhead, char *first)
+{
+    req->nhead = 0;
+    req->job.argc = 0;
+    req->job.argv = NULL;
+    req->job.cwd = NULL;
+    req->job.input = NULL;
+    req->job.output = NULL;
+    req->job.error = NULL;
+    req->job.in = -1;
+    req->job.out = -1;
+
+    if (first) {
+        req->head[req->nhead++] = first;
+    }
+
+    while (req->nhead < nhead && (req->head[req->nhead] = read_field())) {
+        ++req->nhead;
+    }
+
+    if (req->nhead < nhead) {
+        free_job(req);
+        return -1;
+    }
+
+    int argc = atoi(req->head[nhead - 1]);
+
+    if (argc < 1 || !(req->job.argv = calloc(argc + 1, sizeof(char *)))) {
+        free_job(req);
+        return -1;
+    }
+
+    while (req->job.argc < argc) {
+        if (!(req->job.argv[req->job.argc] = read_field())) {
+            free_job(req);
+            return -1;
+        }
+        ++req->job.argc;
+    }
+
+    req->job.tl = atoi(req->head[0]);
+    req->job.ml = atoi(req->head[1]);
+    req->job.rl = atoi(req->head[2]);
+    req->job.ol = atoi(req->head[3]);
+    req->job.cwd = req->head[4][0] ? req->head[4] : NULL;
+
+    return 0;
+}
+
+static void serve(const options_t *opt)
+{
+    // Jobs are read from stdin, each job is a sequence of NUL-terminated
+    // fields: <tl> <ml> <rl> <ol> <cwd> <input> <output> <argc> <args>.
+    // <ol> is the output limit in MiB (0 means no limit).
+    // Empty <cwd> means current directory, empty <input> and <output>
+    // mean /dev/null. For every job a line
+    // "<verdict> <exitcode> <time> <memory>" is written to stdout.
+    //
+    // An interactive job is prefixed by fields of the interactor:
+    // "-i" <tl> <ml> <rl> <ol> <cwd> <error> <argc> <args>, where <error> is
+    // the file to redirect interactor's stderr to. <input> and <output>
+    // of the solution are ignored, the line written for the job is
+    // "<verdict> <exitcode> <time> <memory>" of the solution followed by
+    // the same four fields of the interactor.
+
+    for (;;) {
+        char *first = read_field();
+
+        if (!first) {
+            return;
+        }
+
+        request_t req, ireq;
+        int interactive = !strcmp(first, "-i");
+
+        if (interactive) {
+            free(first);
+
+            if (read_job(&ireq, 7, NULL) < 0) {
+                return;
+            }
+
+            ireq.job.error = ireq.head[5][0] ? ireq.head[5] : "/dev/null";
+            first = NULL;
+        }
+
+        if (read_job(&req, 8, first) < 0) {
+            if (interactive) {
+                free_job(&ireq);
+            }
+            return;
+        }
+
+        req.job.input = req.head[5][0] ? req.head[5] : "/dev/null";
+        req.job.output = req.head[6][0] ? req.head[6] : "/dev/null";
+
+        result_t r, ir;
+
+        if (interactive) {
+            interact(&req.job, &ireq.job, opt, &r, &ir);
+
+            printf("%s %d %d %d %s %d %d %d\n", verdicts[r.verdict + 1],
+                   r.exitcode, r.time, r.memory, verdicts[ir.verdict + 1],
+                   ir.exitcode, ir.time, ir.memory);
+
+            free_job(&ireq);
+        } else {
+            run(&req.job, opt, &r);
+
+            printf("%s %d %d %d\n", verdicts[r.verdict + 1],
+                   r.exitcode, r.time, r.memory);
+        }
+
+        fflush(stdout);
+
+        free_job(&req);
+    }
+}
+
+static void write_result(FILE *f, const char *prefix, const result_t *res)
+{
+    fprintf(f, "%sverdict: %s\n", prefix, verdicts[res->verdict + 1]);
+    fprintf(f, "%sexitcode: %d\n", prefix, res->exitcode);
+    fprintf(f, "%stime: %d\n", prefix, res->time);
+    fprintf(f, "%smemory: %d\n", prefix, res->memory);
+}
+
 int main(int argc, char **argv)
 {
-    // Usage: run <tl> <ml> <rl> <log> <args>
+    // Usage: run [options] <tl> <ml> <rl> <log> <args>
+    //        run [options] -s
+    // Options:
+    //   -c <cpu>    pin the process to the CPU
+    //   -g <dir>    measure and limit the process in a cgroup v2,
+    //               created inside the given (delegated) cgroup
+    //   -i <tl> <ml> <rl> <error> <argc> <args>
+    //               run the process interactively with the interactor,
+    //               given by limits, file to redirect its stderr to,
+    //               and command; the interactor's result is written
+    //               to the log with "interactor_" prefix
+    //   -o <ol>     limit size of files the process writes to <ol> MiB,
+    //               the verdict is OL if it's exceeded (or stdout is
+    //               a regular file, which has grown to the limit)
+    //   -p          collect hardware counters of the process (Linux),
+    //               they are written to the log as instructions, cycles
+    //               and cache_misses (-1 if not available)
+    //   -s          run jobs from stdin until EOF (see serve)
+    //   -t <file>   sample resource usage of the process every TICK
+    //               milliseconds and write it to the file (see sample_t)
+    options_t opt;
+    opt.cpu = -1;
+    opt.cgroup = NULL;
+    opt.perf = 0;
+    opt.trace = NULL;
+
+    job_t ijob;
+    int interactive = 0;
+    int ol = 0;
+
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-c") && argc > 2) {
+            opt.cpu = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else if (!strcmp(argv[1], "-g") && argc > 2) {
+            opt.cgroup = argv[2];
+            write_file(opt.cgroup, "cgroup.subtree_control", "+cpu +memory");
+            argc -= 2;
+            argv += 2;
+        } else if (!strcmp(argv[1], "-i") && argc > 6 &&
+                   atoi(argv[6]) > 0 && argc > 6 + atoi(argv[6])) {
+            interactive = 1;
+            ijob.tl = atoi(argv[2]);
+            ijob.ml = atoi(argv[3]);
+            ijob.rl = atoi(argv[4]);
+            ijob.ol = 0;
+            ijob.error = argv[5];
+            ijob.argc = atoi(argv[6]);
+            ijob.argv = calloc(ijob.argc + 1, sizeof(char *));
+            memcpy(ijob.argv, argv + 7, ijob.argc * sizeof(char *));
+            ijob.cwd = NULL;
+            ijob.input = NULL;
+            ijob.output = NULL;
+            ijob.in = -1;
+            ijob.out = -1;
+            argc -= 6 + ijob.argc;
+            argv += 6 + ijob.argc;
+        } else if (!strcmp(argv[1], "-o") && argc > 2) {
+            ol = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else if (!strcmp(argv[1], "-p")) {
+            opt.perf = 1;
+            argc -= 1;
+            argv += 1;
+        } else if (!strcmp(argv[1], "-t") && argc > 2) {
+            opt.trace = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if (!strcmp(argv[1], "-s")) {
+            serve(&opt);
+            return 0;
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[1]);
+            return 1;
+        }
+    }
+
     if (argc <= 5) {
         fprintf(stderr, "not enough arguments\n");
         return 1;
     }
-    result_t res;
+    result_t res, ires;
 
-    int tl = atoi(argv[1]);
-    int ml = atoi(argv[2]);
-    int rl = atoi(argv[3]);
+    job_t job;
+    job.argc = argc - 5;
+    job.argv = argv + 5;
+    job.tl = atoi(argv[1]);
+    job.ml = atoi(argv[2]);
+    job.rl = atoi(argv[3]);
+    job.ol = ol;
+    job.cwd = NULL;
+    job.input = NULL;
+    job.output = NULL;
+    job.error = NULL;
+    job.in = -1;
+    job.out = -1;
 
-    run(argc - 5, argv + 5, tl, ml, rl, &res);
+    if (interactive) {
+        interact(&job, &ijob, &opt, &res, &ires);
+    } else {
+        run(&job, &opt, &res);
+    }
 
     FILE *f = fopen(argv[4], "w");
-    fprintf(f, "verdict: %s\n", verdicts[res.verdict + 1]);
-    fprintf(f, "exitcode: %d\n", res.exitcode);
-    fprintf(f, "time: %d\n", res.time);
-    fprintf(f, "memory: %d\n", res.memory);
+    write_result(f, "", &res);
+    if (opt.perf) {
+        fprintf(f, "instructions: %lld\n", res.counters[0]);
+        fprintf(f, "cycles: %lld\n", res.counters[1]);
+        fprintf(f, "cache_misses: %lld\n", res.counters[2]);
+    }
+    if (interactive) {
+        write_result(f, "interactor_", &ires);
+    }
     fclose(f);
 
     return 0;
@@ -37,6 +37,10 @@
 #define TL 1
 #define ML 2
 #define RL 3
+#define OL 4
+
+// Output size is checked this often, in milliseconds.
+#define TICK 20
 
 struct result_t {
     int verdict;
@@ -50,7 +54,8 @@ static char *verdicts[] = {
     "OK",
     "TL",
     "ML",
-    "RL"
+    "RL",
+    "OL"
 };
 
 long long FileTimeToLongLong(const FILETIME *ft)
@@ -58,7 +63,16 @@ long long FileTimeToLongLong(const FILETIME *ft)
     return ft->dwLowDateTime + ((long long)ft->dwHighDateTime << 32);
 }
 
-void run(int argc, wchar_t **argv, int tl, int ml, int rl, result_t *res)
+// Checks if stdout is a file, which has grown to ol MiB.
+static bool output_exceeded(HANDLE out, int ol)
+{
+    LARGE_INTEGER size;
+
+    return ol > 0 && GetFileType(out) == FILE_TYPE_DISK &&
+        GetFileSizeEx(out, &size) && size.QuadPart >= (long long)ol * 1024 * 1024;
+}
+
+void run(int argc, wchar_t **argv, int tl, int ml, int rl, int ol, result_t *res)
 {
     res->verdict = -1;
     res->exitcode = 0;
@@ -85,9 +99,31 @@ void run(int argc, wchar_t **argv, int tl, int ml, int rl, result_t *res)
         return;
     }
 
-    if (WaitForSingleObject(pi.hProcess, rl) == WAIT_TIMEOUT) {
-        res->verdict = RL;
-        TerminateProcess(pi.hProcess, 0);
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    int waited = 0;
+
+    for (;;) {
+        int timeout = ol > 0 ? min(TICK, rl - waited) : rl;
+
+        if (WaitForSingleObject(pi.hProcess, max(timeout, 0)) != WAIT_TIMEOUT) {
+            break;
+        }
+
+        waited += timeout;
+
+        if (output_exceeded(out, ol)) {
+            res->verdict = OL;
+            TerminateProcess(pi.hProcess, 0);
+            WaitForSingleObject(pi.hProcess, INFINITE);
+            break;
+        }
+
+        if (waited >= rl) {
+            res->verdict = RL;
+            TerminateProcess(pi.hProcess, 0);
+            WaitForSingleObject(pi.hProcess, INFINITE);
+            break;
+        }
     }
 
     PROCESS_MEMORY_COUNTERS mc;
@@ -107,7 +143,9 @@ void run(int argc, wchar_t **argv, int tl, int ml, int rl, result_t *res)
     }
 
     if (res->verdict == -1) {
-        if (res->time >= tl) {
+        if (output_exceeded(out, ol)) {
+            res->verdict = OL;
+        } else if (res->time >= tl) {
             res->verdict = TL;
         } else if (res->memory >= ml) {
             res->verdict = ML;
@@ -129,10 +167,20 @@ void run(int argc, wchar_t **argv, int tl, int ml, int rl, result_t *res)
 
 int main()
 {
-    // Usage: run <tl> <ml> <rl> <log> <args>
+    // Usage: run [options] <tl> <ml> <rl> <log> <args>
+    // Options:
+    //   -o <ol>     kill the process once stdout, redirected to a file,
+    //               has grown to <ol> MiB, the verdict is OL then
 
     int argc;
     wchar_t **argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    int ol = 0;
+
+    if (argc > 2 && !wcscmp(argv[1], L"-o")) {
+        ol = _wtoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
 
     if (argc <= 5) {
         fprintf(stderr, "not enough arguments\n");
@@ -144,7 +192,7 @@ int main()
     int ml = _wtoi(argv[2]);
     int rl = _wtoi(argv[3]);
 
-    run(argc - 5, argv + 5, tl, ml, rl, &res);
+    run(argc - 5, argv + 5, tl, ml, rl, ol, &res);
 
     FILE *f = _wfopen(argv[4], L"w");
     fprintf(f, "verdict: %s\n", verdicts[res.verdict + 1]);
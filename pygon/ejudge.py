@@ -27,7 +27,10 @@ import io
 import tarfile
 import base64
 import shlex
-from shutil import copy2
+import subprocess
+from shutil import copy2, rmtree
+
+from pygon.scheduler import use_pool
 
 
 TEST_PAT = "%02d"
@@ -87,38 +90,150 @@ def generate_config(problem, language=None, prefix=None):
     return f.read()
 
 
-def export_problem(problem, target, language=None, prefix=None):
-    """Exports problem to target directory."""
+def stage_file(src, dst):
+    """Makes dst a copy of src, unless it already is one: either the same
+    file, or a file of the same size and modification time (copies
+    preserve it). dst is hardlinked to src where possible, and is
+    replaced atomically otherwise.
+
+    Returns:
+        bool: True if dst was written.
+    """
+
+    try:
+        if os.path.samefile(src, dst):
+            return False
+        src_stat, dst_stat = os.stat(src), os.stat(dst)
+        if src_stat.st_size == dst_stat.st_size and \
+                src_stat.st_mtime_ns == dst_stat.st_mtime_ns:
+            return False
+    except OSError:
+        pass
+
+    tmp = os.path.join(os.path.dirname(dst),
+                       ".{}.tmp".format(os.path.basename(dst)))
+
+    try:
+        os.remove(tmp)
+    except OSError:
+        pass
+
+    try:
+        os.link(src, tmp)
+    except OSError:
+        copy2(src, tmp)
+
+    os.replace(tmp, dst)
+    return True
+
+
+def remove_stale(directory, names):
+    """Removes everything inside directory except for names."""
+
+    for name in os.listdir(directory):
+        if name in names:
+            continue
+        path = os.path.join(directory, name)
+        if os.path.isdir(path) and not os.path.islink(path):
+            rmtree(path)
+        else:
+            os.remove(path)
+
+
+def get_problem_files(problem, target):
+    """Returns a list of pairs (source, destination) of files to be
+    staged to export problem to target directory."""
+
+    files = [(problem.active_checker.get_executable_path(),
+              os.path.join(target, CHECK_CMD))]
+
+    main = problem.get_main_solution()
+
+    for test in problem.get_solution_tests():
+        files.append((test.get_input_path(),
+                      os.path.join(target, "tests", TEST_PAT % test.index)))
+
+        files.append((test.get_output_path(main.identifier),
+                      os.path.join(target, "tests", CORR_PAT % test.index)))
+
+    return files
+
+
+def prepare_problem(problem, target, language=None, prefix=None):
+    """Writes problem's config to target directory and removes files left
+    from the previous exports.
+
+    Returns:
+        list: pairs (source, destination) of files to be staged, see
+        get_problem_files.
+    """
+
+    files = get_problem_files(problem, target)
 
-    os.makedirs(target, exist_ok=True)
     os.makedirs(os.path.join(target, "tests"), exist_ok=True)
 
     with open(os.path.join(target, "problem.cfg"), "w") as f:
         f.write(generate_config(problem, language=language, prefix=prefix))
 
-    copy2(problem.active_checker.get_executable_path(),
-             os.path.join(target, CHECK_CMD))
+    remove_stale(target, {"problem.cfg", CHECK_CMD, "tests"})
+    remove_stale(os.path.join(target, "tests"),
+                 {os.path.basename(dst) for src, dst in files})
 
-    main = problem.get_main_solution()
+    return files
 
-    for test in problem.get_solution_tests():
-        copy2(test.get_input_path(),
-                 os.path.join(target, "tests", TEST_PAT % test.index))
 
-        copy2(test.get_output_path(main.identifier),
-                 os.path.join(target, "tests", CORR_PAT % test.index))
+def stage_files(files, jobs=1, pool=None):
+    """Stages files simultaneously, see stage_file.
+
+    Args:
+        files: list of pairs (source, destination).
+        jobs: number of files to stage simultaneously.
+        pool: Pool to use instead of a new one.
+
+    Returns:
+        int: number of written files.
+    """
 
+    with use_pool(jobs, pool, pin=False) as pool:
+        return sum(pool.map(lambda x, worker: stage_file(*x), files))
 
-def export_contest(contest, target, language=None):
-    """Exports contest to target directory."""
 
-    os.makedirs(target, exist_ok=True)
+def export_problem(problem, target, language=None, prefix=None, jobs=1,
+                   pool=None):
+    """Exports problem to target directory. Only changed files
+    are written, files left from the previous exports are removed.
+
+    Args:
+        problem: the Problem.
+        target: the directory.
+        language: language of the problem's name.
+        prefix: problem's short name in the contest.
+        jobs: number of files to stage simultaneously.
+        pool: Pool to use instead of a new one.
+    """
+
+    files = prepare_problem(problem, target, language=language, prefix=prefix)
+    stage_files(files, jobs=jobs, pool=pool)
+
+
+def export_contest(contest, target, language=None, jobs=1, pool=None):
+    """Exports contest to target directory. Files of all problems
+    are staged simultaneously, see export_problem.
+    """
+
     os.makedirs(os.path.join(target, "problems"), exist_ok=True)
 
+    files = []
+    names = set()
+
     for prefix, problem in contest.problems:
-        export_problem(problem,
-                       os.path.join(target, "problems", problem.internal_name),
-                       language=language, prefix=prefix)
+        names.add(problem.internal_name)
+        files += prepare_problem(
+            problem, os.path.join(target, "problems", problem.internal_name),
+            language=language, prefix=prefix)
+
+    remove_stale(os.path.join(target, "problems"), names)
+    stage_files(files, jobs=jobs, pool=pool)
 
     last_id = 0
     with open(os.path.join(target, "contest.cfg"), "w") as f:
@@ -135,6 +250,38 @@ def export_contest(contest, target, language=None):
         f.write(PATCHER)
 
 
+def write_archive(target, path):
+    """Writes contents of target directory to a tar archive at path,
+    which is compressed according to its extension: ".tar.gz" (or
+    ".tgz"), ".tar.xz", ".tar.bz2", ".tar.zst" (requires zstd) or
+    uncompressed otherwise. The archive extracts to the contest
+    directory the same way as write_script does.
+    """
+
+    if not path.endswith(".zst"):
+        mode = "w"
+        for ext, compression in ((".gz", "gz"), (".tgz", "gz"),
+                                 (".xz", "xz"), (".bz2", "bz2")):
+            if path.endswith(ext):
+                mode = "w:" + compression
+
+        with tarfile.open(path, mode) as f:
+            f.add(target, arcname=".")
+        return
+
+    with open(path, "wb") as out:
+        proc = subprocess.Popen(["zstd", "-q", "-T0"], stdin=subprocess.PIPE,
+                                stdout=out)
+        try:
+            with tarfile.open(fileobj=proc.stdin, mode="w|") as f:
+                f.add(target, arcname=".")
+        finally:
+            proc.stdin.close()
+            if proc.wait():
+                raise OSError("zstd failed with exit code {}".format(
+                    proc.returncode))
+
+
 def write_script(target, contest_dir=None, fd=sys.stdout):
     archive = io.BytesIO()
 
@@ -0,0 +1,85 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""This module defines helpers for staging files in and out of
+working directories of solutions without copying their contents
+where the filesystem allows it."""
+
+import os
+import shutil
+
+try:
+    import fcntl
+except ImportError:
+    fcntl = None
+
+# ioctl request number of FICLONE (see ioctl_ficlone(2))
+FICLONE = 0x40049409
+
+
+def try_reflink(src, dst):
+    """Tries to make dst a copy-on-write clone of src (Btrfs, XFS).
+    The contents are not copied, but changes to the clone don't affect
+    the original. Existing dst is replaced.
+
+    Returns:
+        bool: True if succeeded, and False otherwise.
+    """
+
+    if fcntl is None:
+        return False
+
+    try:
+        with open(src, "rb") as fsrc, open(dst, "wb") as fdst:
+            fcntl.ioctl(fdst.fileno(), FICLONE, fsrc.fileno())
+    except OSError:
+        try:
+            os.remove(dst)
+        except OSError:
+            pass
+        return False
+
+    return True
+
+
+def clone_file(src, dst):
+    """Makes dst an independent copy of src: a reflink if the filesystem
+    supports it, otherwise an in-kernel copy.
+    Unlike a hardlink, writes to dst never change src.
+    """
+
+    if not try_reflink(src, dst):
+        shutil.copyfile(src, dst)
+
+
+def move_file(src, dst):
+    """Moves src to dst, replacing it. A rename if both are on the same
+    filesystem, otherwise a clone of src (which is then removed).
+    """
+
+    try:
+        os.replace(src, dst)
+        return
+    except OSError:
+        pass
+
+    clone_file(src, dst)
+    os.remove(src)
@@ -24,6 +24,7 @@
 import subprocess
 
 from pygon.source import Source
+from pygon.tracing import span
 
 
 class Generator(Source):
@@ -53,5 +54,6 @@ class Generator(Source):
 
         cmd = self.get_execute_command()
         cmd += args
-        with open(path, 'wb') as test:
-            subprocess.run(cmd, stdout=test, check=True)
+        with span(" ".join([self.identifier] + args), "generate"):
+            with open(path, 'wb') as test:
+                subprocess.run(cmd, stdout=test, check=True)
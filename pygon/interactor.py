@@ -23,10 +23,12 @@
 
 import os
 import subprocess
+import tempfile
 from collections import namedtuple
 
 from pygon.source import Source
 from pygon.testcase import Verdict
+from pygon.invoke import Runner
 
 
 class Interactor(Source):
@@ -49,6 +51,10 @@ class Interactor(Source):
         """Interacts with a solution on a test.
         Expects interactor to be already compiled.
 
+        The interactor and the solution are run together by the run
+        utility, the interactor's time limit is the solution's real
+        time limit.
+
         Args:
             inp: path to the test's input file.
             out: path to the interactor's output on this test.
@@ -60,6 +66,39 @@ class Interactor(Source):
 
         cmd = self.get_execute_command()
         cmd += [inp, out]
+
+        if not Runner.supports_interaction():
+            return self.interact_pipes(cmd, invoke)
+
+        fd, error = tempfile.mkstemp(prefix="pygon-interactor-")
+        os.close(fd)
+
+        try:
+            res, ires = invoke.interact(
+                cmd, time_limit=5 * invoke.time_limit,
+                memory_limit=invoke.memory_limit, error=error)
+
+            with open(error, "rb") as f:
+                res.icomment = f.read().decode(errors="replace").strip()
+        finally:
+            os.remove(error)
+
+        if res.verdict != Verdict.OK:
+            return res
+
+        if ires.verdict != Verdict.OK:
+            res.verdict = Verdict.CHECK_FAILED
+            res.icomment = "Interactor got {}. {}".format(
+                ires.verdict.value, res.icomment).strip()
+            return res
+
+        return self.apply_exitcode(res, ires.exitcode)
+
+    def interact_pipes(self, cmd, invoke):
+        """Interacts with a solution, running the interactor directly
+        (without limits), for platforms where run utility can't
+        run interactively."""
+
         rd, wr = os.pipe()
         proc = subprocess.Popen(cmd, stdin=rd,
                                 stdout=subprocess.PIPE,
@@ -76,12 +115,19 @@ class Interactor(Source):
         if res.verdict != Verdict.OK:
             return res
 
+        return self.apply_exitcode(res, proc.returncode)
+
+    @staticmethod
+    def apply_exitcode(res, exitcode):
+        """Sets verdict of the solution's result according to
+        the interactor's exit code."""
+
         res.verdict = Verdict.CHECK_FAILED
-        if proc.returncode == 0:
+        if exitcode == 0:
             res.verdict = Verdict.OK
-        elif proc.returncode == 1:
+        elif exitcode == 1:
             res.verdict = Verdict.WRONG_ANSWER
-        elif proc.returncode == 2:
+        elif exitcode == 2:
             res.verdict = Verdict.PRESENTATION_ERROR
 
         return res
@@ -24,9 +24,12 @@ measuring their execution time."""
 
 import os
 import sys
+import shutil
+import struct
 import subprocess
 import tempfile
-from shutil import copyfile
+import threading
+from collections import namedtuple
 from contextlib import contextmanager
 
 import yaml
@@ -35,6 +38,7 @@ from pkg_resources import resource_filename
 from pygon.testcase import Verdict
 from pygon.language import Language
 from pygon.config import CONFIG, BUILD_DIR
+from pygon.fileutil import clone_file, move_file
 
 
 def get_exe_suffix():
@@ -46,10 +50,16 @@ def get_exe_suffix():
     return ""
 
 
+def is_run_bundled():
+    """Returns True if prebuilt run utility bundled with pygon is used."""
+
+    return not CONFIG.get("custom_run") and sys.platform in ["win32", "cygwin"]
+
+
 def get_run_path():
     """Returns path to run utility executable."""
 
-    if not CONFIG.get("custom_run") and sys.platform in ["win32", "cygwin"]:
+    if is_run_bundled():
         return resource_filename(
             "pygon",
             os.path.join("data", "run", "run_win32.exe")
@@ -62,11 +72,193 @@ def get_run_path():
     )
 
 
-def ensure_run_built():
-    """Compile run utility if it isn't built."""
+def get_run_options(cpu=None, counters=False, trace=None):
+    """Returns options for run utility as a list of strings.
+
+    Args:
+        cpu: CPU to pin the command to, or None.
+        counters: whether to collect hardware counters.
+        trace: path to write the trace of resource usage to, or None
+               (see read_trace).
+    """
+
+    # The Windows run utility doesn't support any options.
+    if sys.platform in ["win32", "cygwin"]:
+        return []
+
+    res = []
+
+    if cpu is not None:
+        res += ["-c", str(cpu)]
+
+    if CONFIG.get("cgroup"):
+        res += ["-g", CONFIG["cgroup"]]
+
+    if counters:
+        res += ["-p"]
+
+    if trace:
+        res += ["-t", trace]
+
+    return res
+
+
+def get_limit_args(time_limit, memory_limit):
+    """Returns time, memory and real time limits as arguments
+    for run utility.
+
+    Args:
+        time_limit: time limit in seconds.
+        memory_limit: memory limit in MiB.
+    """
+
+    return [
+        str(round(1000 * time_limit)),
+        str(round(memory_limit)),
+        str(round(5000 * time_limit)),
+    ]
+
+
+def read_run_log(path, prefix=""):
+    """Reads a result from the log written by run utility.
+
+    Args:
+        path: path to the log.
+        prefix: prefix of the result's keys.
+
+    Returns:
+        InvokeResult
+    """
+
+    with open(path) as logf:
+        log = yaml.safe_load(logf.read())
+
+    res = InvokeResult(Verdict(log[prefix + "verdict"]),
+                       log[prefix + "time"] / 1000,
+                       log[prefix + "memory"],
+                       exitcode=log[prefix + "exitcode"])
+
+    if "instructions" in log and not prefix:
+        res.counters = {i: log[i] if log[i] >= 0 else None
+                        for i in COUNTERS}
+
+    return res
+
+
+# Header and format of samples of traces written by run utility.
+TRACE_MAGIC = b"PYGTRC01"
+TRACE_SAMPLE = struct.Struct("=IIIIQQ")
+
+TraceSample = namedtuple("TraceSample",
+                         ["time", "cpu", "rss", "state", "read", "written"])
+TraceSample.__doc__ = """A sample of resource usage of a running process.
 
-    if os.path.exists(get_run_path()):
-        return
+Attributes:
+    time: real time since the start in seconds.
+    cpu: CPU time in seconds.
+    rss: resident set size in MiB.
+    state: state of the process (e.g. "R" if running, "S" if sleeping,
+           "D" if waiting for disk).
+    read: bytes read so far (including pipes).
+    written: bytes written so far.
+"""
+
+
+def read_trace(path):
+    """Reads a trace of resource usage written by run utility.
+    Samples are taken every few milliseconds while the process runs.
+
+    Returns:
+        list: TraceSamples, or an empty list if the trace is missing.
+    """
+
+    try:
+        with open(path, "rb") as f:
+            data = f.read()
+    except OSError:
+        return []
+
+    if not data.startswith(TRACE_MAGIC):
+        return []
+
+    data = data[len(TRACE_MAGIC):]
+    data = data[:len(data) - len(data) % TRACE_SAMPLE.size]
+    res = []
+
+    for fields in TRACE_SAMPLE.iter_unpack(data):
+        time, cpu, rss, state, read, written = fields
+        res.append(TraceSample(time / 1000, cpu / 1000, rss / 1024,
+                               chr(state), read, written))
+
+    return res
+
+
+def summarize_trace(samples):
+    """Summarizes a trace of resource usage.
+
+    Args:
+        samples: list of TraceSamples.
+
+    Returns:
+        dict: peak_rss and average_rss (MiB), cpu_share (CPU time per real
+        time), read and written (bytes), io_share (share of the time
+        spent waiting for I/O which made progress), stall_share (share of
+        the time spent sleeping without any I/O), and flags: a list of
+        "io-bound", "stalled", "memory-growing". Or None for empty traces.
+    """
+
+    if not samples:
+        return None
+
+    last = samples[-1]
+    io = stall = 0
+
+    for prev, cur in zip(samples, samples[1:]):
+        if cur.state in "RZX":
+            continue
+        if cur.read != prev.read or cur.written != prev.written or \
+                cur.state == "D":
+            io += 1
+        elif cur.cpu == prev.cpu:
+            stall += 1
+
+    steps = max(len(samples) - 1, 1)
+    quarter = max(len(samples) // 4, 1)
+    first = sum(i.rss for i in samples[:quarter]) / quarter
+    final = sum(i.rss for i in samples[-quarter:]) / quarter
+    peak = max(range(len(samples)), key=lambda i: samples[i].rss)
+
+    res = dict(
+        peak_rss=samples[peak].rss,
+        average_rss=sum(i.rss for i in samples) / len(samples),
+        cpu_share=last.cpu / last.time if last.time > 0 else 1.0,
+        read=last.read,
+        written=last.written,
+        io_share=io / steps,
+        stall_share=stall / steps,
+        flags=[],
+    )
+
+    if res["io_share"] >= 0.5:
+        res["flags"].append("io-bound")
+    if res["stall_share"] >= 0.5:
+        res["flags"].append("stalled")
+    # Memory is still growing by the end of the run.
+    if len(samples) >= 8 and final > 1.5 * first and \
+            peak >= len(samples) - quarter:
+        res["flags"].append("memory-growing")
+
+    return res
+
+
+_run_build_lock = threading.Lock()
+
+# Hardware counters run utility collects (see get_run_options).
+COUNTERS = ["instructions", "cycles", "cache_misses"]
+
+
+def ensure_run_built():
+    """Compile run utility if it isn't built or is older than its source."""
 
     if sys.platform == "win32":
         run_filename = "run_win32.cpp"
@@ -75,11 +267,212 @@ def ensure_run_built():
         run_filename = "run_posix.c"
         lang = Language.from_name("c99")
 
-    lang.compile(
-        resource_filename("pygon", os.path.join("data", "run", run_filename)),
-        get_run_path(),
-        []
-    )
+    src = resource_filename("pygon", os.path.join("data", "run", run_filename))
+
+    with _run_build_lock:
+        if os.path.exists(get_run_path()):
+            if is_run_bundled():
+                return
+            if os.path.getmtime(get_run_path()) >= os.path.getmtime(src):
+                return
+
+        os.makedirs(os.path.dirname(get_run_path()), exist_ok=True)
+        lang.compile(src, get_run_path(), [])
+
+
+class Runner:
+    """A long-lived run utility process, which runs commands one by one.
+    Saves a process spawn, a temporary directory and a YAML log per run.
+    Only commands with stdin and stdout redirected to files can be run.
+    """
+
+    def __init__(self, cpu=None):
+        """Starts the run utility.
+
+        Args:
+            cpu: CPU to pin the commands to, or None.
+        """
+
+        ensure_run_built()
+
+        self.cmd = [get_run_path()] + get_run_options(cpu) + ["-s"]
+
+        self.proc = None
+
+    @staticmethod
+    def is_supported():
+        """Returns True if run utility on this platform supports
+        running multiple commands."""
+
+        return sys.platform not in ["win32", "cygwin"]
+
+    @staticmethod
+    def supports_interaction():
+        """Returns True if run utility on this platform can run commands
+        interactively with an interactor (see interact). The Windows one
+        can't."""
+
+        return sys.platform not in ["win32", "cygwin"]
+
+    @classmethod
+    def get(cls, worker):
+        """Returns the worker's runner, or None if not supported."""
+
+        if worker is None or not cls.is_supported():
+            return None
+
+        return worker.get("runner", lambda: cls(cpu=worker.cpu))
+
+    def run(self, cmd, cwd, stdin, stdout, time_limit, memory_limit,
+            output_limit=None):
+        """Run the command.
+
+        Args:
+            cmd: command to run as a list of strings.
+            cwd: working directory (or None).
+            stdin: path to the file to redirect stdin from.
+            stdout: path to the file to redirect stdout to.
+            time_limit: time limit in seconds.
+            memory_limit: memory limit in MiB.
+            output_limit: limit of size of the files the command writes
+                          in MiB, or None.
+
+        Returns:
+            InvokeResult
+        """
+
+        fields = get_limit_args(time_limit, memory_limit) + [
+            str(round(output_limit or 0)),
+            cwd or "",
+            stdin,
+            stdout,
+            str(len(cmd))
+        ] + cmd
+
+        return self._submit(fields, 1)[0]
+
+    def interact(self, cmd, cwd, time_limit, memory_limit,
+                 icmd, itime_limit, imemory_limit, ierror):
+        """Run the command interactively with an interactor: stdout of
+        each of them is connected to stdin of the other one.
+        Once one of them gets a verdict deciding the outcome,
+        the other one is killed. Both are killed if they are
+        waiting for each other.
+
+        Args:
+            cmd: command to run as a list of strings.
+            cwd: working directory (or None).
+            time_limit: time limit in seconds.
+            memory_limit: memory limit in MiB.
+            icmd: command of the interactor as a list of strings.
+            itime_limit: time limit of the interactor in seconds.
+            imemory_limit: memory limit of the interactor in MiB.
+            ierror: path to the file to redirect interactor's stderr to.
+
+        Returns:
+            tuple: InvokeResults of the command and the interactor.
+        """
+
+        fields = ["-i"] + get_limit_args(itime_limit, imemory_limit) + [
+            "0",
+            "",
+            ierror,
+            str(len(icmd))
+        ] + icmd + get_limit_args(time_limit, memory_limit) + [
+            "0",
+            cwd or "",
+            "",
+            "",
+            str(len(cmd))
+        ] + cmd
+
+        return self._submit(fields, 2)
+
+    def _submit(self, fields, count):
+        if self.proc is None or self.proc.poll() is not None:
+            self.proc = subprocess.Popen(self.cmd, stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE,
+                                         stderr=subprocess.DEVNULL)
+
+        job = b"".join(os.fsencode(i) + b"\0" for i in fields)
+
+        try:
+            self.proc.stdin.write(job)
+            self.proc.stdin.flush()
+            line = self.proc.stdout.readline().decode().split()
+        except BrokenPipeError:
+            line = []
+
+        if len(line) < 4 * count:
+            self.close()
+            raise RuntimeError("run utility terminated unexpectedly")
+
+        return [InvokeResult(Verdict(line[i]), int(line[i + 2]) / 1000,
+                             int(line[i + 3]), exitcode=int(line[i + 1]))
+                for i in range(0, 4 * count, 4)]
+
+    def close(self):
+        """Stops the run utility."""
+
+        if self.proc is None:
+            return
+
+        self.proc.stdin.close()
+        self.proc.wait()
+        self.proc.stdout.close()
+        self.proc = None
+
+
+class Sandbox:
+    """A working directory reused by consecutive runs of a worker,
+    it's emptied after every run. Creating a fresh directory per run
+    is slow on Windows, where it's also scanned by antivirus.
+
+    Attributes:
+        path: path to the directory.
+    """
+
+    def __init__(self, dir=None):
+        """Creates the directory.
+
+        Args:
+            dir: directory to create it in (by default, the system's
+                 temporary directory).
+        """
+
+        self.dir = dir
+        self.path = tempfile.mkdtemp(dir=dir, prefix=".run-")
+
+    @classmethod
+    def get(cls, worker, dir=None):
+        """Returns the worker's sandbox in the directory, or None
+        if there's no worker."""
+
+        if worker is None:
+            return None
+
+        return worker.get(("sandbox", dir), lambda: cls(dir))
+
+    def clear(self):
+        """Removes everything from the directory. If something can't be
+        removed (e.g. it's still open by a process being killed),
+        a new directory is used from now on."""
+
+        try:
+            for name in os.listdir(self.path):
+                path = os.path.join(self.path, name)
+                if os.path.isdir(path) and not os.path.islink(path):
+                    shutil.rmtree(path)
+                else:
+                    os.remove(path)
+        except OSError:
+            shutil.rmtree(self.path, ignore_errors=True)
+            self.path = tempfile.mkdtemp(dir=self.dir, prefix=".run-")
+
+    def close(self):
+        """Removes the directory."""
+
+        shutil.rmtree(self.path, ignore_errors=True)
 
 
 class InvokeResult:
@@ -91,14 +484,21 @@ class InvokeResult:
         memory: memory used in MiB
         comment: checker's comment
         icomment: interactor's comment
+        exitcode: exit code of the process (negative signal number if it was
+                  killed by a signal); it's not saved in verdict files
+        counters: None, or a dict of hardware counters (see COUNTERS) if
+                  they were requested (None values if not available)
     """
 
-    def __init__(self, verdict, time, memory, comment="", icomment=""):
+    def __init__(self, verdict, time, memory, comment="", icomment="",
+                 exitcode=0):
         self.verdict = verdict
         self.time = time
         self.memory = memory
         self.comment = comment
         self.icomment = icomment
+        self.exitcode = exitcode
+        self.counters = None
 
     def to_dict(self):
         return dict(
@@ -127,55 +527,139 @@ class Invoke:
         cwd: working directory of the command.
         stdin: file-like instance to redirect stdin from.
         stdout: file-like instance to redirect stdout to.
+        stdin_path: path to the file stdin is redirected from (or None).
+        stdout_path: path to the file stdout is redirected to (or None).
         time_limit: time limit in seconds.
         memory_limit: memory limit in MiB.
+        output_limit: limit of size of the files the command writes in MiB
+                      (OL verdict), or None. It's not enforced by the
+                      prebuilt run utility on Windows.
+        cpu: CPU to pin the command to, or None.
+        runner: Runner to run the command with, or None.
+        counters: whether to collect hardware counters (the runner
+                  is not used then).
+        trace: path to write the trace of resource usage to, or None
+               (see read_trace; the runner is not used then). It's not
+               supported on Windows.
     """
 
-    def __init__(self, cmd, time_limit=1.0, memory_limit=256.0):
+    def __init__(self, cmd, time_limit=1.0, memory_limit=256.0, cpu=None,
+                 runner=None, counters=False, output_limit=None, trace=None):
         """Construct an Invoke instance."""
 
         self.cmd = cmd
         self.cwd = None
         self.stdin = None
         self.stdout = None
+        self.stdin_path = None
+        self.stdout_path = None
         self.time_limit = time_limit
         self.memory_limit = memory_limit
-
+        self.output_limit = output_limit
+        self.cpu = cpu
+        self.runner = runner
+        self.counters = counters
+        self.trace = trace
 
     def run(self):
         """Run the command."""
 
+        if self.runner and self.stdin_path and self.stdout_path and \
+                not self.counters and not self.trace:
+            return self.runner.run(self.cmd, self.cwd,
+                                   self.stdin_path, self.stdout_path,
+                                   self.time_limit, self.memory_limit,
+                                   self.output_limit)
+
         ensure_run_built()
 
         with tempfile.TemporaryDirectory() as dirpath:
             logpath = os.path.join(dirpath, "run.yaml")
 
-            cmd = [
-                get_run_path(),
-                str(round(1000 * self.time_limit)),
-                str(round(self.memory_limit)),
-                str(round(5000 * self.time_limit)),
-                logpath
-            ] + self.cmd
+            cmd = [get_run_path()] + \
+                get_run_options(self.cpu, self.counters, self.trace) + \
+                self.get_output_limit_options() + \
+                get_limit_args(self.time_limit, self.memory_limit) + \
+                [logpath] + self.cmd
 
             subprocess.run(cmd, stdin=self.stdin, stdout=self.stdout,
                            stderr=subprocess.DEVNULL, cwd=self.cwd,
                            check=True)
 
-            with open(logpath) as logf:
-                log = yaml.safe_load(logf.read())
+            return read_run_log(logpath)
 
-            time_used = log["time"] / 1000
-            memory_used = log["memory"]
-            verdict = Verdict(log["verdict"])
+    def get_output_limit_options(self):
+        """Returns options of run utility for the output limit."""
 
-            return InvokeResult(verdict, time_used, memory_used)
+        if not self.output_limit or is_run_bundled():
+            return []
 
-    @contextmanager
-    def with_temp_cwd(self):
-        """Use temporary working directory."""
+        return ["-o", str(round(self.output_limit))]
+
+    def interact(self, icmd, time_limit, memory_limit, error):
+        """Run the command interactively with an interactor
+        (see Runner.interact). Not supported on Windows
+        (see Runner.supports_interaction).
+
+        Args:
+            icmd: command of the interactor as a list of strings.
+            time_limit: time limit of the interactor in seconds.
+            memory_limit: memory limit of the interactor in MiB.
+            error: path to the file to redirect interactor's stderr to.
+
+        Returns:
+            tuple: InvokeResults of the command and the interactor.
+        """
+
+        if self.runner and not self.trace and Runner.supports_interaction():
+            return self.runner.interact(self.cmd, self.cwd,
+                                        self.time_limit, self.memory_limit,
+                                        icmd, time_limit, memory_limit,
+                                        error)
+
+        ensure_run_built()
 
         with tempfile.TemporaryDirectory() as dirpath:
+            logpath = os.path.join(dirpath, "run.yaml")
+
+            cmd = [get_run_path()] + \
+                get_run_options(self.cpu, trace=self.trace) + ["-i"] + \
+                get_limit_args(time_limit, memory_limit) + \
+                [error, str(len(icmd))] + icmd + \
+                get_limit_args(self.time_limit, self.memory_limit) + \
+                [logpath] + self.cmd
+
+            subprocess.run(cmd, stdin=subprocess.DEVNULL,
+                           stdout=subprocess.DEVNULL,
+                           stderr=subprocess.DEVNULL, cwd=self.cwd,
+                           check=True)
+
+            return (read_run_log(logpath),
+                    read_run_log(logpath, prefix="interactor_"))
+
+    @contextmanager
+    def with_temp_cwd(self, dir=None, sandbox=None):
+        """Use temporary working directory.
+
+        Args:
+            dir: directory to create it in (by default, the system's
+                 temporary directory). Files are staged in and out of the
+                 working directory without copying if it's on the same
+                 filesystem as the input and the output.
+            sandbox: Sandbox to use (and empty afterwards) instead
+                     of creating a directory, or None.
+        """
+
+        if sandbox:
+            self.cwd = sandbox.path
+            try:
+                yield
+            finally:
+                self.cwd = None
+                sandbox.clear()
+            return
+
+        with tempfile.TemporaryDirectory(dir=dir, prefix=".run-") as dirpath:
             self.cwd = dirpath
             yield
 
@@ -193,13 +677,16 @@ class Invoke:
         if filename.stdio:
             with open(path, 'rb') as input_file:
                 self.stdin = input_file
+                self.stdin_path = path
                 yield
         else:
-            copyfile(path, os.path.join(self.cwd, filename.filename))
+            clone_file(path, os.path.join(self.cwd, filename.filename))
             self.stdin = subprocess.DEVNULL
+            self.stdin_path = os.devnull
             yield
 
         self.stdin = None
+        self.stdin_path = None
 
     @contextmanager
     def with_stdout(self, filename, path):
@@ -213,10 +700,13 @@ class Invoke:
         if filename.stdio:
             with open(path, 'wb') as output_file:
                 self.stdout = output_file
+                self.stdout_path = path
                 yield
         else:
             self.stdout = subprocess.DEVNULL
+            self.stdout_path = os.devnull
             yield
-            copyfile(os.path.join(self.cwd, filename.filename), path)
+            move_file(os.path.join(self.cwd, filename.filename), path)
 
         self.stdout = None
+        self.stdout_path = None
@@ -23,11 +23,51 @@
 
 import subprocess
 import shlex
+import shutil
 import os
 from abc import ABC, abstractmethod
 
 from pygon.config import CONFIG
 
+# Commands are formatted and split often, so they are remembered,
+# keyed by the template and the arguments.
+_commands = {}
+
+_program_ids = {}
+
+
+def get_program_id(program):
+    """Returns a string identifying an installed program (e.g. a compiler)
+    by its path, size and modification time, like ccache does."""
+
+    if program not in _program_ids:
+        path = shutil.which(program) or program
+        try:
+            stat = os.stat(path)
+            res = "{} {} {}".format(os.path.realpath(path), stat.st_size,
+                                    stat.st_mtime_ns)
+        except OSError:
+            res = program
+        _program_ids[program] = res
+
+    return _program_ids[program]
+
+
+def format_command(template, **kwargs):
+    """Formats a command template and splits it into a list of strings.
+
+    Args:
+        template: a command with placeholders (e.g. "g++ {src} -o {exe}").
+        kwargs: values of placeholders, already quoted for shell.
+    """
+
+    key = (template,) + tuple(sorted(kwargs.items()))
+
+    if key not in _commands:
+        _commands[key] = shlex.split(template.format(**kwargs))
+
+    return list(_commands[key])
+
 
 class Language(ABC):
     """Programming language / compiler."""
@@ -58,6 +98,54 @@ class Language(ABC):
             None or execution command as a list of strings.
         """
 
+    @property
+    def pch(self):
+        """Whether testlib.h may be precompiled for this language."""
+
+        return True
+
+    def get_pch_command(self, header, pch, res):
+        """Returns a command precompiling a C++ header, or None if
+        the compiler isn't known to support precompiled headers.
+        The header is compiled with the same options as sources,
+        except for libraries to link.
+
+        Args:
+            header: absolute path to the header.
+            pch: absolute path to the precompiled header
+                 (should be named "<header>.gch").
+            res: list of resource directories.
+        """
+
+        if not self.pch:
+            return None
+
+        cmd = self.get_compile_command(header, pch, res)
+
+        if not cmd or not os.path.basename(cmd[0]).startswith(("g++", "clang++")):
+            return None
+
+        if header not in cmd:
+            return None
+
+        index = cmd.index(header)
+        cmd = [i for i in cmd[:index] if not i.startswith("-l")] + \
+            ["-x", "c++-header"] + \
+            [i for i in cmd[index:] if not i.startswith("-l")]
+
+        return cmd
+
+    def get_compiler_id(self):
+        """Returns a string identifying the compiler (see get_program_id),
+        or an empty string if sources aren't compiled."""
+
+        cmd = self.get_compile_command("{src}", "{exe}", [])
+
+        if not cmd:
+            return ""
+
+        return get_program_id(cmd[0])
+
     @staticmethod
     def autodetect(name):
         """Returns language appropriate for a file name.
@@ -86,12 +174,17 @@ class Language(ABC):
 
         compile_cmd = cfg.get('compile')
         execute_cmd = cfg.get('execute', '{exe}')
+        use_pch = cfg.get('pch', True)
 
         class CustomLanguage(Language):
             @property
             def name(self):
                 return name
 
+            @property
+            def pch(self):
+                return use_pch
+
             def get_compile_command(self, src, exe, res):
                 if not compile_cmd:
                     return None
@@ -106,13 +199,12 @@ class Language(ABC):
                 else:
                     src = shlex.quote(src)
 
-                return shlex.split(compile_cmd.format(src=src,
-                                                      exe=shlex.quote(exe),
-                                                      inc=inc))
+                return format_command(compile_cmd, src=src,
+                                      exe=shlex.quote(exe), inc=inc)
 
             def get_execute_command(self, src, exe):
-                return shlex.split(execute_cmd.format(src=shlex.quote(src),
-                                                      exe=shlex.quote(exe)))
+                return format_command(execute_cmd, src=shlex.quote(src),
+                                      exe=shlex.quote(exe))
 
         return CustomLanguage()
 
@@ -22,16 +22,21 @@
 """This module defines class for working with problems."""
 
 import os
+import shlex
 import subprocess
 import glob
-from shutil import rmtree
+import threading
 
 import yaml
 from loguru import logger
 
 from pygon.testcase import FileName, SolutionTest, CheckerTest, Verdict
-from pygon.testcase import expand_generator_command, ValidatorTest
+from pygon.testcase import ValidatorTest, iter_generator_command
+from pygon.testcase import count_generator_command
 from pygon.config import TEST_FORMAT, BUILD_DIR
+from pygon.scheduler import use_pool
+from pygon.cache import Cache
+from pygon.tracing import traced
 from pygon.ejudge import export_problem as ejudge_export
 
 
@@ -50,6 +55,7 @@ class Problem:
         interactive (bool): is this problem interactive?
         time_limit (float): time limit in seconds
         memory_limit (float): memory limit in MiB
+        output_limit (float): output limit in MiB
         active_checker (Checker): active checker for the problem (or None)
         active_interactor (Interactor): active interactor for the problem (or None)
         active_validators (list): list of active Validators for the problem
@@ -68,6 +74,7 @@ class Problem:
         self.interactive = False
         self.time_limit = 1.0
         self.memory_limit = 256.0
+        self.output_limit = 256.0
         self.active_checker = None
         self.active_interactor = None
         self.active_validators = []
@@ -88,6 +95,7 @@ class Problem:
         self.interactive = data.get("interactive", False)
         self.time_limit = data.get("time_limit", 1.0)
         self.memory_limit = data.get("memory_limit", 256.0)
+        self.output_limit = data.get("output_limit", 256.0)
 
         chk = data.get("active_checker")
 
@@ -108,6 +116,11 @@ class Problem:
         for i in data.get("active_validators", []):
             self.active_validators.append(Validator.from_identifier(i, self))
 
+    def get_cache(self):
+        """Returns the Cache for the problem's artifacts."""
+
+        return Cache.get(self.root)
+
     def get_source_filename(self, directory, name):
         """Get a source filename from identifier, or determine that
         the source doesn't exist.
@@ -338,8 +351,9 @@ class Problem:
         for test in self.get_solution_tests():
             if test.generate:
                 line = "G"
-                exp = expand_generator_command(test.generate)
-                if len(exp) != 1 or exp[0] != test.generate:
+                if count_generator_command(test.generate) != 1 or \
+                        next(iter_generator_command(test.generate)) != \
+                        test.generate:
                     line += "R"
             else:
                 line = "M"
@@ -391,7 +405,7 @@ class Problem:
                     tests.append(test)
             elif flags[0] == "G":
                 if "R" not in flags:
-                    for i in expand_generator_command(arg):
+                    for i in iter_generator_command(arg):
                         test = test.copy()
                         test["generate"] = i
                         tests.append(test)
@@ -464,7 +478,8 @@ class Problem:
 
         return True
 
-    def build(self, statements=True):
+    @traced("build")
+    def build(self, statements=True, jobs=1, pool=None):
         """Build the problem verifying that:
 
         - There is an active checker and it compiles
@@ -475,15 +490,24 @@ class Problem:
         - Main solution gets OK
 
         Should be ran prior to verification.
+
+        All sources (including generators) are compiled up front,
+        simultaneously. Then each test goes through its own pipeline:
+        generate, validate, judge the main solution. Pipelines of
+        different tests run simultaneously.
+
+        Args:
+            statements: whether to build statements.
+            jobs: number of tests to process simultaneously
+                  (0 means the number of CPUs).
+            pool: if set, the Pool to run jobs in instead of a new one
+                  (e.g. shared by all problems of a contest).
         """
 
         if not self.active_checker:
             raise ProblemConfigurationError("Active checker is not set")
 
-        try:
-            self.active_checker.ensure_compile()
-        except subprocess.CalledProcessError:
-            raise ProblemConfigurationError("Active checker compilation failed")
+        sources = [(self.active_checker, "Active checker compilation failed")]
 
         if self.interactive:
             if not self.input_file.stdio or not self.output_file.stdio:
@@ -492,29 +516,21 @@ class Problem:
             if not self.active_interactor:
                 raise ProblemConfigurationError("Active interactor is not set")
 
-            try:
-                self.active_interactor.ensure_compile()
-            except subprocess.CalledProcessError:
-                raise ProblemConfigurationError("Active interactor compilation failed")
+            sources.append((self.active_interactor,
+                            "Active interactor compilation failed"))
 
         main_solution = self.get_main_solution()
 
-        try:
-            main_solution.ensure_compile()
-        except subprocess.CalledProcessError:
-            raise ProblemConfigurationError("Main solution compilation failed")
+        sources.append((main_solution, "Main solution compilation failed"))
 
         for validator in self.active_validators:
-            try:
-                validator.ensure_compile()
-            except subprocess.CalledProcessError:
-                raise ProblemConfigurationError(
-                    "Validator {} compilation failed".format(validator)
-                )
+            sources.append((validator, "Validator {} compilation failed"
+                            .format(validator)))
 
-        tests = self.get_solution_tests()
+        for generator in self.get_generators():
+            sources.append((generator, "Generator compilation failed"))
 
-        for test in tests:
+        def process(test, worker):
             try:
                 test.build()
             except subprocess.CalledProcessError:
@@ -530,8 +546,7 @@ class Problem:
                             verdict.comment
                         ))
 
-        for test in tests:
-            verdict = main_solution.judge(test)
+            verdict = main_solution.judge(test, worker)
 
             if not main_solution.tag.check_one(verdict.verdict):
                 raise ProblemConfigurationError(
@@ -542,19 +557,210 @@ class Problem:
                         verdict.comment
                     ))
 
-        if statements:
-            for stmt in self.get_statements():
-                try:
-                    stmt.build()
-                except subprocess.CalledProcessError:
-                    raise ProblemConfigurationError(
-                        "Failed to build {} statement. See '{}' for details".format(
-                            stmt.language, stmt.get_log_path()
-                        ))
+        with use_pool(jobs, pool) as pool:
+            self.compile_sources(sources, pool=pool)
+
+            for _ in pool.imap_unordered(process, self.get_solution_tests()):
+                pass
+
+            if statements:
+                pool.map(lambda stmt, worker: self.build_statement(stmt),
+                         self.get_statements())
 
         logger.success("Problem built successfully")
 
-    def verify(self):
+    def build_statement(self, stmt):
+        """Builds a statement of the problem.
+
+        Raises:
+            ProblemConfigurationError: if the statement fails to build.
+        """
+
+        try:
+            stmt.build()
+        except subprocess.CalledProcessError:
+            raise ProblemConfigurationError(
+                "Failed to build {} statement. See '{}' for details".format(
+                    stmt.language, stmt.get_log_path()
+                ))
+
+    def get_generators(self):
+        """Returns a list of Generators used by the problem's tests
+        (unknown ones are skipped, they fail when generating).
+        """
+
+        from pygon.generator import Generator
+        from pygon.source import UnknownSourceError
+
+        names = []
+        for test in self.get_solution_tests():
+            if test.generate:
+                name = shlex.split(test.generate)[0]
+                if name not in names:
+                    names.append(name)
+
+        res = []
+        for name in names:
+            try:
+                res.append(Generator.from_identifier(name, self))
+            except UnknownSourceError:
+                pass
+
+        return res
+
+    def compile_sources(self, sources, jobs=1, pool=None):
+        """Compiles sources (unless they are fresh) simultaneously.
+
+        Args:
+            sources: a list of pairs (Source, error message).
+            jobs: number of sources to compile simultaneously
+                  (0 means the number of CPUs).
+            pool: if set, the Pool to run jobs in instead of a new one.
+
+        Raises:
+            ProblemConfigurationError: with the message of the first
+                                       source, which failed to compile.
+        """
+
+        def job(source, worker):
+            try:
+                source.ensure_compile()
+            except subprocess.CalledProcessError:
+                return False
+            return True
+
+        with use_pool(jobs, pool, pin=False) as pool:
+            results = pool.map(job, [i[0] for i in sources])
+
+        for (source, message), ok in zip(sources, results):
+            if not ok:
+                raise ProblemConfigurationError(message)
+
+    def judge_solutions(self, solutions, tests, jobs=1, fail_fast=False,
+                        callback=None, pool=None):
+        """Judges solutions on tests, possibly simultaneously.
+        Solutions must be already compiled.
+
+        Args:
+            solutions: a list of Solutions.
+            tests: a list of SolutionTests.
+            jobs: number of solutions to judge simultaneously
+                  (0 means the number of CPUs).
+            fail_fast: if True, tests likely to fail a solution are judged
+                       first, and a solution is no longer judged once
+                       its tag check is decided (see SolutionTag.is_decided).
+            callback: if set, called as callback(solution, test, result)
+                      when a solution is judged on a test.
+            pool: if set, the Pool to run jobs in instead of a new one.
+
+        Returns:
+            list: list of lists, i-th list contains results (InvokeResult)
+                  of i-th solution on the tests, None for skipped tests.
+        """
+
+        order = []
+        for solution in solutions:
+            if fail_fast:
+                prio = solution.prioritize_tests(tests)
+                order.append([tests.index(i) for i in prio])
+            else:
+                order.append(list(range(len(tests))))
+
+        verdicts = [[] for _ in solutions]
+
+        def job(item, worker):
+            i, j = item
+            if fail_fast and solutions[i].tag.is_decided(verdicts[i]):
+                return None
+            res = solutions[i].judge(tests[j], worker)
+            verdicts[i].append(res.verdict)
+            return res
+
+        def done(item, res):
+            if callback and res:
+                callback(solutions[item[0]], tests[item[1]], res)
+
+        items = []
+        for rank in range(len(tests)):
+            for i in range(len(solutions)):
+                items.append((i, order[i][rank]))
+
+        results = [[None] * len(tests) for _ in solutions]
+
+        with use_pool(jobs, pool) as pool:
+            for item, res in zip(items, pool.map(job, items, callback=done)):
+                results[item[0]][item[1]] = res
+
+        return results
+
+    def stress(self, solutions, commands, dirname, jobs=1, callback=None):
+        """Stress-tests solutions for tag violations on generated tests,
+        possibly simultaneously. Problem must be already built.
+
+        Once a solution violates its tag, it's no longer judged, and once
+        all of them do, the rest of the tests are not generated at all.
+
+        Args:
+            solutions: a list of Solutions.
+            commands: an iterable of generation commands (e.g. "gen 1 2 3").
+            dirname: path to a temporary directory to generate tests in.
+            jobs: number of tests to process simultaneously
+                  (0 means the number of CPUs).
+            callback: if set, called as callback(command) when
+                      a test is processed.
+
+        Returns:
+            tuple: (offenders, verdicts), i-th offender is the first
+                   command i-th solution violates its tag on (or None),
+                   i-th element of verdicts is a set of Verdicts
+                   i-th solution got.
+        """
+
+        main_solution = self.get_main_solution()
+
+        offenders = [None] * len(solutions)
+        verdicts = [set() for _ in solutions]
+        # Guards offenders, so that the first offending command wins.
+        lock = threading.Lock()
+
+        def job(item, worker):
+            index, cmd = item
+            test = SolutionTest(problem=self, generate=cmd,
+                                dirname=os.path.join(dirname,
+                                                     str(worker.index)))
+            pending = [i for i in range(len(solutions))
+                       if offenders[i] is None]
+            if not pending:
+                return
+
+            test.build()
+            main_solution.judge(test, worker)
+
+            for i in pending:
+                if offenders[i] is not None and offenders[i][0] < index:
+                    continue
+                res = solutions[i].judge(test, worker)
+                with lock:
+                    verdicts[i].add(res.verdict)
+                    if not solutions[i].tag.check_one(res.verdict) and \
+                            (offenders[i] is None or offenders[i][0] > index):
+                        offenders[i] = (index, cmd)
+
+        with use_pool(jobs) as pool:
+            results = pool.imap_unordered(job, enumerate(commands))
+            try:
+                for (index, cmd), _ in results:
+                    if callback:
+                        callback(cmd)
+                    if all(offenders):
+                        break
+            finally:
+                results.close()
+
+        return [i and i[1] for i in offenders], verdicts
+
+    @traced("verify")
+    def verify(self, jobs=1, fail_fast=False, pool=None):
         """Build and lint problem for configuration errors.
         Raises errors when:
 
@@ -571,19 +777,32 @@ class Problem:
         - No tests.
         - Sample tests are not first.
 
+        Args:
+            jobs: number of tests to build and solutions to judge
+                  simultaneously (0 means the number of CPUs).
+            fail_fast: stop judging solutions once their tag check is
+                       decided (see Problem.judge_solutions).
+            pool: if set, the Pool to run jobs in instead of a new one
+                  (e.g. shared by all problems of a contest).
         """
 
         from pygon.solution import Solution
 
-        self.build(statements=False)
+        with use_pool(jobs, pool) as pool:
+            self.build(statements=False, pool=pool)
 
-        solutions = Solution.all(self)
-        tests = self.get_solution_tests()
+            solutions = Solution.all(self)
+            tests = self.get_solution_tests()
 
-        for solution in solutions:
-            verdicts = []
-            for test in tests:
-                verdicts.append(solution.judge(test).verdict)
+            self.compile_sources([(i, "Solution {} compilation failed"
+                                   .format(i.identifier)) for i in solutions],
+                                 pool=pool)
+
+            results = self.judge_solutions(solutions, tests,
+                                           fail_fast=fail_fast, pool=pool)
+
+        for solution, res in zip(solutions, results):
+            verdicts = [i.verdict for i in res if i]
             if solution.tag.check_all(verdicts):
                 logger.success("Solution {} has correct tag"
                                .format(solution.identifier))
@@ -627,9 +846,15 @@ class Problem:
         else:
             logger.warning("No test cases found")
 
-    def ejudge_export(self, language=None):
-        """Export problem in ejudge format to BUILD_ROOT/ejudge"""
+    def ejudge_export(self, language=None, jobs=1, pool=None):
+        """Export problem in ejudge format to BUILD_ROOT/ejudge.
+        Only changed files are written.
+
+        Args:
+            language: language of problems' names.
+            jobs: number of files to stage simultaneously.
+            pool: Pool to use instead of a new one.
+        """
 
         path = os.path.join(self.root, BUILD_DIR, "ejudge")
-        rmtree(path, ignore_errors=True)
-        ejudge_export(self, path, language=language)
+        ejudge_export(self, path, language=language, jobs=jobs, pool=pool)
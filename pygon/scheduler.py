@@ -0,0 +1,253 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""This module defines a pool of workers for running independent jobs
+(e.g. judging solutions on tests) simultaneously."""
+
+import os
+import queue
+import threading
+from contextlib import contextmanager
+from concurrent.futures import ThreadPoolExecutor, FIRST_COMPLETED, wait
+
+_local = threading.local()
+
+
+def get_context():
+    """Returns the calling thread's context: a dict of values (e.g. the
+    problem messages are logged for), which jobs it submits inherit."""
+
+    if not hasattr(_local, "context"):
+        _local.context = {}
+
+    return _local.context
+
+
+def run_in_context(context, func, *args):
+    """Calls func(*args) with a copy of context as the thread's context,
+    restoring the previous one afterwards."""
+
+    saved = get_context()
+    _local.context = dict(context)
+
+    try:
+        return func(*args)
+    finally:
+        _local.context = saved
+
+
+def get_cpus():
+    """Returns a sorted list of CPUs this process is allowed to run on."""
+
+    try:
+        return sorted(os.sched_getaffinity(0))
+    except AttributeError:
+        return list(range(os.cpu_count() or 1))
+
+
+class Worker:
+    """A slot in the Pool. Jobs running at the same time
+    always get different workers.
+
+    Attributes:
+        index: 0-based index of the worker in its pool.
+        cpu: CPU which processes started by this worker are pinned to,
+             or None if they are not pinned.
+    """
+
+    def __init__(self, index, cpu=None):
+        self.index = index
+        self.cpu = cpu
+        self._objects = {}
+
+    def get(self, key, factory):
+        """Returns a long-lived object (e.g. a helper process) owned
+        by the worker, constructing it with factory() on first use.
+        Objects are closed along with the worker.
+        """
+
+        if key not in self._objects:
+            self._objects[key] = factory()
+
+        return self._objects[key]
+
+    def close(self):
+        """Releases resources held by the worker."""
+
+        for obj in self._objects.values():
+            obj.close()
+
+        self._objects = {}
+
+
+class Pool:
+    """A pool of workers, running jobs simultaneously.
+    Jobs are plain functions, which accept an item and a Worker.
+
+    With one job at a time, jobs are run in the calling thread,
+    in order, just like an ordinary loop would do.
+
+    A pool may be shared by several threads (e.g. problems of a contest
+    built at the same time): the number of jobs running simultaneously
+    is limited by the number of workers regardless of their origin.
+    Jobs run in a copy of the submitting thread's context (see get_context).
+
+    Attributes:
+        jobs: number of jobs to run simultaneously.
+        workers: list of Workers.
+    """
+
+    def __init__(self, jobs=1, pin=None):
+        """Constructs a Pool.
+
+        Args:
+            jobs: number of jobs to run simultaneously,
+                  0 means the number of available CPUs.
+            pin: whether to pin workers to CPUs, by default only
+                 if more than one job is run simultaneously.
+        """
+
+        cpus = get_cpus()
+
+        if jobs < 1:
+            jobs = len(cpus)
+
+        if pin is None:
+            pin = jobs > 1
+
+        self.jobs = jobs
+        self.workers = []
+
+        for i in range(jobs):
+            cpu = cpus[i] if pin and i < len(cpus) else None
+            self.workers.append(Worker(i, cpu=cpu))
+
+        self._free = queue.Queue()
+        for worker in self.workers:
+            self._free.put(worker)
+
+        self._executor = None
+        if jobs > 1:
+            self._executor = ThreadPoolExecutor(max_workers=jobs)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        """Waits for running jobs and releases the workers."""
+
+        if self._executor:
+            self._executor.shutdown(wait=True)
+            self._executor = None
+
+        for worker in self.workers:
+            worker.close()
+
+    def _run(self, func, item):
+        worker = self._free.get()
+        try:
+            return func(item, worker)
+        finally:
+            self._free.put(worker)
+
+    def imap_unordered(self, func, items):
+        """Runs func(item, worker) for every item.
+        Items are consumed lazily: only a few jobs are scheduled ahead.
+        Jobs which did not start yet are cancelled when the
+        caller stops iterating (or one of the jobs raises).
+
+        Args:
+            func: the job.
+            items: an iterable of items.
+
+        Yields:
+            pairs (item, result) in order of job completion.
+        """
+
+        if not self._executor:
+            for item in items:
+                yield item, self._run(func, item)
+            return
+
+        items = iter(items)
+        pending = {}
+
+        def schedule():
+            for item in items:
+                future = self._executor.submit(
+                    run_in_context, dict(get_context()), self._run, func, item)
+                pending[future] = item
+                if len(pending) >= 2 * self.jobs:
+                    break
+
+        try:
+            schedule()
+            while pending:
+                done, _ = wait(pending, return_when=FIRST_COMPLETED)
+                for future in done:
+                    item = pending.pop(future)
+                    yield item, future.result()
+                schedule()
+        finally:
+            for future in pending:
+                future.cancel()
+            wait(pending)
+
+    def map(self, func, items, callback=None):
+        """Runs func(item, worker) for every item.
+
+        Args:
+            func: the job.
+            items: an iterable of items.
+            callback: if set, called in the calling thread
+                      as callback(item, result) when a job is done.
+
+        Returns:
+            list: results of the jobs, in order of items.
+        """
+
+        items = list(items)
+        res = [None] * len(items)
+
+        for (index, item), result in self.imap_unordered(
+                lambda x, worker: func(x[1], worker), enumerate(items)):
+            res[index] = result
+            if callback:
+                callback(item, result)
+
+        return res
+
+
+@contextmanager
+def use_pool(jobs=1, pool=None, **kwargs):
+    """Returns a context manager, yielding pool if it is set (it's left
+    open), or a new Pool(jobs, **kwargs) otherwise (it's closed on exit).
+    """
+
+    if pool is not None:
+        yield pool
+        return
+
+    with Pool(jobs, **kwargs) as res:
+        yield res
@@ -28,8 +28,10 @@ from loguru import logger
 
 from pygon.language import Language
 from pygon.source import Source
-from pygon.invoke import Invoke, InvokeResult
+from pygon.invoke import Invoke, InvokeResult, Runner, Sandbox
 from pygon.testcase import Verdict
+from pygon.cache import hash_file, make_key, is_fresh, remove_stamps
+from pygon.tracing import span
 
 
 class SolutionTag:
@@ -107,6 +109,28 @@ class SolutionTag:
 
         return any([i != Verdict.OK for i in verdicts])
 
+    def is_decided(self, verdicts):
+        """Checks if judging the solution on more tests is pointless:
+        either one of the results is already invalid, or an incorrect
+        solution has met its tag by getting a non-OK verdict.
+        Note, that in the latter case verdicts on the rest of the tests
+        are not verified to be among the allowed ones.
+
+        Args:
+            verdicts: a list of Verdicts, which the solution got so far.
+
+        Returns:
+            True if the result of check_all is known, and False otherwise.
+        """
+
+        if not all([self.check_one(i) for i in verdicts]):
+            return True
+
+        if self.tag != "incorrect":
+            return False
+
+        return any([i != Verdict.OK for i in verdicts])
+
 
 class Solution(Source):
     """A solution for a problem"""
@@ -145,11 +169,18 @@ class Solution(Source):
                 data["verdicts"] = self.tag.verdicts
             data = yaml.dump(data, desc, default_flow_style=False)
 
-    def invoke(self, test):
+    def invoke(self, test, worker=None, output=None, time_limit=None,
+               counters=False, trace=None):
         """Invoke solution on a test (without running a checker).
 
         Args:
             test (SolutionTest): the test
+            worker (Worker): the pool's worker running the solution (or None)
+            output: path to write the output to (by default, the test's
+                    output path of the solution)
+            time_limit: time limit in seconds (by default, the problem's)
+            counters: whether to collect hardware counters (see Invoke)
+            trace: path to write the trace of resource usage to (see Invoke)
 
         Returns:
             InvokeResult
@@ -158,93 +189,284 @@ class Solution(Source):
         self.ensure_compile()
 
         invoke = Invoke(self.get_execute_command(),
-                        time_limit=self.problem.time_limit,
-                        memory_limit=self.problem.memory_limit)
+                        time_limit=time_limit or self.problem.time_limit,
+                        memory_limit=self.problem.memory_limit,
+                        cpu=worker.cpu if worker else None,
+                        runner=Runner.get(worker),
+                        counters=counters,
+                        output_limit=self.problem.output_limit,
+                        trace=trace)
 
         inp = test.get_input_path()
-        out = test.get_output_path(self.identifier)
+        out = output or test.get_output_path(self.identifier)
 
         os.makedirs(os.path.dirname(out), exist_ok=True)
 
+        sandbox = Sandbox.get(worker, os.path.dirname(out))
+
         if self.problem.interactive:
-            with invoke.with_temp_cwd():
+            with invoke.with_temp_cwd(os.path.dirname(out), sandbox):
                 return self.problem.active_interactor.interact(
                     inp, out, invoke
                 )
 
-        with invoke.with_temp_cwd():
+        with invoke.with_temp_cwd(os.path.dirname(out), sandbox):
             with invoke.with_stdin(self.problem.input_file, inp):
                 with invoke.with_stdout(self.problem.output_file, out):
-                    return invoke.run()
+                    res = invoke.run()
 
+        # The output may have reached the limit without the run utility
+        # noticing (e.g. the solution ignored SIGXFSZ).
+        if res.verdict == Verdict.OK and os.path.exists(out) and \
+                os.path.getsize(out) >= self.problem.output_limit * 2 ** 20:
+            res.verdict = Verdict.OUTPUT_LIMIT_EXCEEDED
 
-    def need_judge(self, test):
-        """Do we have the freshest possible verdict on running solution
-        on this test?
+        return res
+
+
+    def get_last_verdict(self, test):
+        """Returns the Verdict the solution got on the test last time
+        it was judged (even if it's out of date), or None.
 
         Args:
             test (SolutionTest): the test.
+        """
+
+        try:
+            with open(test.get_verdict_path(self.identifier)) as f:
+                return Verdict(yaml.safe_load(f)["verdict"])
+        except (OSError, ValueError, KeyError, TypeError):
+            return None
+
+    def prioritize_tests(self, tests):
+        """Orders tests so that tests most likely to decide the solution's
+        fate go first: tests it failed last time, then smaller tests.
+
+        Args:
+            tests: a list of SolutionTests.
 
         Returns:
-            bool: if True then we need to rejudge.
+            list: the same tests, reordered.
         """
 
-        deps = [
-            test.get_input_path(),
-            test.get_output_path(self.problem.get_main_solution().identifier),
-            self.get_source_path(),
-            self.get_descriptor_path(),
-            self.problem.active_checker.get_executable_path()
+        def key(test):
+            verdict = self.get_last_verdict(test)
+            try:
+                size = os.path.getsize(test.get_input_path())
+            except OSError:
+                size = 0
+            return (verdict is None or verdict == Verdict.OK, size)
+
+        return sorted(tests, key=key)
+
+    def get_run_key(self, test):
+        """Returns a key, identifying the result of running the solution
+        on a test (its output, time and memory usage): a hash of
+        the solution, the test (and the interactor) and the limits.
+
+        Args:
+            test (SolutionTest): the test.
+
+        Raises:
+            OSError: if some of the dependencies doesn't exist.
+        """
+
+        parts = [
+            self.get_build_key(),
+            hash_file(test.get_input_path()),
+            self.problem.time_limit,
+            self.problem.memory_limit,
+            self.problem.output_limit,
+            str(self.problem.input_file),
+            str(self.problem.output_file),
         ]
 
         if self.problem.interactive:
-            deps.append(self.problem.active_interactor.get_executable_path())
+            parts.append(self.problem.active_interactor.get_build_key())
+
+        return make_key(*parts)
+
+    def get_judge_key(self, test, run_key, run_result):
+        """Returns a key, identifying the result of judging the solution
+        on a test: a hash of the run and, if the run is OK, of the output,
+        the answer and the checker.
+
+        Args:
+            test (SolutionTest): the test.
+            run_key: key of the run, see get_run_key.
+            run_result (InvokeResult): result of the run.
+
+        Raises:
+            OSError: if some of the dependencies doesn't exist.
+        """
+
+        if run_result.verdict != Verdict.OK:
+            return make_key(run_key, run_result.verdict.value)
+
+        main_solution = self.problem.get_main_solution()
+
+        parts = [
+            run_key,
+            hash_file(test.get_output_path(self.identifier)),
+            self.problem.active_checker.get_build_key(),
+        ]
+
+        if self.identifier != main_solution.identifier:
+            parts.append(hash_file(
+                test.get_output_path(main_solution.identifier)))
+
+        return make_key(*parts)
+
+    def get_run_artifacts(self, test):
+        """Returns a dict of artifacts produced by running on a test."""
 
-        verdict_path = test.get_verdict_path(self.identifier)
+        return dict(output=test.get_output_path(self.identifier),
+                    run=test.get_run_path(self.identifier))
+
+    def get_judge_artifacts(self, test):
+        """Returns a dict of artifacts produced by judging the run."""
+
+        return dict(verdict=test.get_verdict_path(self.identifier))
+
+    def fetch_run(self, test, key):
+        """Returns the result of running the solution on a test with key
+        if it's available (in place or in the cache), or None."""
+
+        artifacts = self.get_run_artifacts(test)
+
+        with span("{} on test {}".format(self.identifier, test.index),
+                  "cache"):
+            if not is_fresh(artifacts.values(), key) and \
+                    not self.problem.get_cache().fetch(key, artifacts):
+                return None
+
+            with open(artifacts["run"]) as f:
+                return InvokeResult.from_dict(yaml.safe_load(f))
+
+    def need_judge(self, test):
+        """Do we have the freshest possible verdict on running solution
+        on this test (either in place or in the cache)?
+        The solution's run is fetched from the cache if it's there.
+
+        Args:
+            test (SolutionTest): the test.
+
+        Returns:
+            bool: if True then we need to rejudge.
+        """
+
+        if test.dirname:
+            return True
 
         try:
-            self_time = os.path.getmtime(verdict_path)
+            run_key = self.get_run_key(test)
+            run_result = self.fetch_run(test, run_key)
+            if run_result is None:
+                return True
+            key = self.get_judge_key(test, run_key, run_result)
         except OSError:
             return True
 
-        for i in deps:
-            if self_time < os.path.getmtime(i):
-                return True
+        artifacts = self.get_judge_artifacts(test)
+
+        if is_fresh(artifacts.values(), key):
+            return False
 
-        return False
+        return not self.problem.get_cache().contains(key, artifacts)
 
-    def judge(self, test):
+    def judge(self, test, worker=None):
         """Runs and judges solution on a test if neccessary.
+        Runs and verdicts are cached separately: e.g. if only the checker
+        changes, the saved outputs are checked again without running.
+        Verdicts on temporary (stress) tests are not saved.
 
         Args:
             test (SolutionTest): the test.
+            worker (Worker): the pool's worker running the solution (or None)
 
         Returns:
             InvokeResult
         """
 
-        if not self.need_judge(test):
-            with open(test.get_verdict_path(self.identifier)) as f:
-                return InvokeResult.from_dict(yaml.safe_load(f))
+        if test.dirname:
+            res = self.invoke(test, worker=worker)
+            return self.check(test, res, worker=worker)
 
-        main_solution = self.problem.get_main_solution()
+        run_artifacts = self.get_run_artifacts(test)
+        artifacts = self.get_judge_artifacts(test)
+        cache = self.problem.get_cache()
+
+        name = "{} on test {}".format(self.identifier, test.index)
+
+        self.ensure_compile()
+
+        run_key = self.get_run_key(test)
+        res = self.fetch_run(test, run_key)
+
+        if res is None:
+            remove_stamps(list(run_artifacts.values()) +
+                          list(artifacts.values()))
+
+            logger.info("Judging {solution} on test {test}",
+                        solution=self.identifier,
+                        test=test.index)
+
+            with span(name, "run"):
+                res = self.invoke(test, worker=worker)
+
+            with span(name, "yaml"):
+                with open(run_artifacts["run"], "w") as f:
+                    yaml.dump(res.to_dict(), f, default_flow_style=False)
+
+            with span(name, "cache"):
+                cache.store(run_key, run_artifacts)
+
+        with span(name, "cache"):
+            key = self.get_judge_key(test, run_key, res)
+            fresh = is_fresh(artifacts.values(), key) or \
+                cache.fetch(key, artifacts)
+
+        if fresh:
+            with span(name, "yaml"):
+                with open(artifacts["verdict"]) as f:
+                    return InvokeResult.from_dict(yaml.safe_load(f))
+
+        remove_stamps(artifacts.values())
 
-        logger.info("Judging {solution} on test {test}",
-                    solution=self.identifier,
-                    test=test.index)
+        res = self.check(test, res, worker=worker)
 
-        res = self.invoke(test)
+        with span(name, "yaml"):
+            with open(artifacts["verdict"], "w") as f:
+                yaml.dump(res.to_dict(), f, default_flow_style=False)
+
+        with span(name, "cache"):
+            cache.store(key, artifacts)
+
+        return res
+
+    def check(self, test, res, worker=None):
+        """Checks the output of a run with the active checker,
+        unless the run has already failed.
+
+        Args:
+            test (SolutionTest): the test.
+            res (InvokeResult): result of the run, it's updated in place.
+            worker (Worker): the pool's worker running the checker (or None)
+
+        Returns:
+            InvokeResult: res.
+        """
 
         if res.verdict == Verdict.OK:
+            main_solution = self.problem.get_main_solution()
+
             inp = test.get_input_path()
             out = test.get_output_path(self.identifier)
             ans = test.get_output_path(main_solution.identifier)
 
-            chk = self.problem.active_checker.judge(inp, out, ans)
+            chk = self.problem.active_checker.judge(inp, out, ans,
+                                                    worker=worker)
             res.verdict = chk.verdict
             res.comment = chk.comment
 
-        with open(test.get_verdict_path(self.identifier), "w") as f:
-            yaml.dump(res.to_dict(), f, default_flow_style=False)
-
         return res
@@ -22,6 +22,8 @@
 """This module defines classes for working sources."""
 
 import os
+import subprocess
+import threading
 from abc import ABC
 
 import yaml
@@ -29,13 +31,99 @@ from pkg_resources import resource_filename
 from loguru import logger
 
 from pygon.language import Language
-from pygon.config import BUILD_DIR
+from pygon.config import CONFIG, BUILD_DIR
+from pygon.tracing import span
+from pygon.cache import (Cache, hash_file, hash_dir, make_key, is_fresh,
+                         remove_stamps, read_stamp, write_stamp,
+                         get_compression)
 
 
 class UnknownSourceError(Exception):
     """Raised when source with specified name could not be found."""
 
 
+_compile_locks = {}
+_compile_locks_guard = threading.Lock()
+
+
+def get_compile_lock(path):
+    """Returns a lock, guarding compilation of the executable at path."""
+
+    with _compile_locks_guard:
+        return _compile_locks.setdefault(path, threading.Lock())
+
+
+def get_compile_cache():
+    """Returns the Cache shared by all executables of the user (like ccache),
+    or None if it's disabled by setting "compile_cache_dir" to ""."""
+
+    directory = CONFIG.get("compile_cache_dir")
+
+    if directory is None:
+        directory = CONFIG.get("cache_dir")
+
+    if directory is None:
+        directory = os.path.join(
+            os.environ.get("XDG_CACHE_HOME", os.path.join("~", ".cache")),
+            "pygon", "executables")
+
+    if not directory:
+        return None
+
+    return Cache(os.path.expanduser(directory), compression=get_compression())
+
+
+def ensure_pch(lang):
+    """Precompiles testlib.h bundled with pygon for a language,
+    unless it's already done or the compiler doesn't support it.
+
+    Returns:
+        Path to directory with the precompiled header, which should
+        precede the bundled resources directory in the include path,
+        or None if there's no precompiled header.
+    """
+
+    header = resource_filename("pygon",
+                               os.path.join("data", "resources", "testlib.h"))
+    dirname = resource_filename("pygon",
+                                os.path.join("data", BUILD_DIR, "pch", lang.name))
+    pch = os.path.join(dirname, "testlib.h.gch")
+
+    cmd = lang.get_pch_command(header, pch, [])
+
+    if not cmd:
+        return None
+
+    key = make_key(cmd, hash_file(header), lang.get_compiler_id())
+
+    with get_compile_lock(pch):
+        if is_fresh([pch], key):
+            return dirname
+
+        # Don't retry if the compiler has already failed.
+        if read_stamp(pch) == "failed " + key:
+            return None
+
+        logger.info("Precompiling testlib.h for {}", lang.name)
+
+        os.makedirs(dirname, exist_ok=True)
+        remove_stamps([pch])
+
+        try:
+            with span("testlib.h for {}".format(lang.name), "compile"):
+                subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+        except (OSError, subprocess.CalledProcessError):
+            if os.path.exists(pch):
+                os.remove(pch)
+            write_stamp(pch, "failed " + key)
+            return None
+
+        write_stamp(pch, key)
+
+    return dirname
+
+
 class Source(ABC):
     """A source file.
 
@@ -191,32 +279,88 @@ class Source(ABC):
 
         dirname = os.path.dirname(self.get_executable_path())
         os.makedirs(dirname, exist_ok=True)
-        self.lang.compile(self.get_source_path(), self.get_executable_path(),
-                          self.get_resource_dirs())
+
+        res = self.get_resource_dirs()
+
+        if self.uses_testlib():
+            pch = ensure_pch(self.lang)
+            if pch:
+                # Bundled testlib.h is the last one in the search order.
+                res.insert(len(res) - 1, pch)
+
+        with span("compile {}".format(self.identifier), "compile"):
+            self.lang.compile(self.get_source_path(),
+                              self.get_executable_path(), res)
+
+    def uses_testlib(self):
+        """Checks if the source includes testlib.h."""
+
+        try:
+            with open(self.get_source_path(), "rb") as f:
+                return b"testlib.h" in f.read()
+        except OSError:
+            return False
+
+    def get_cache(self):
+        """Returns the Cache for the source's artifacts."""
+
+        cache = get_compile_cache()
+
+        if cache:
+            return cache
+
+        if self.standard:
+            return Cache.get(resource_filename("pygon", "data"))
+
+        return Cache.get(self.problem.root)
+
+    def get_build_key(self):
+        """Returns a key, identifying the executable: a hash of the source
+        code, the language's commands and the resource directories.
+
+        Raises:
+            OSError: if source file doesn't exist or is inaccessible.
+        """
+
+        return make_key(
+            self.lang.get_compile_command("{src}", "{exe}", []),
+            self.lang.get_execute_command("{src}", "{exe}"),
+            self.lang.get_compiler_id(),
+            hash_file(self.get_source_path()),
+            *[hash_dir(i) for i in self.get_resource_dirs()]
+        )
 
     def ensure_compile(self):
-        """Compiles the source if executable is missing or
-        is older than the source file.
+        """Compiles the source unless the executable was already built
+        from the same source code with the same compiler.
+        The executable may be taken from the cache instead of compiling.
 
         Raises:
             OSError: if source file doesn't exist or is inaccessible.
             CalledProcessError: if compiler returns non-zero exit code.
         """
 
-        src_time = os.path.getmtime(self.get_source_path())
+        exe = self.get_executable_path()
 
-        if self.standard:
-            desc_time = float("-inf")
-        else:
-            desc_time = os.path.getmtime(self.get_descriptor_path())
+        if not self.lang.get_compile_command(self.get_source_path(), exe,
+                                             self.get_resource_dirs()):
+            return
 
-        try:
-            exe_time = os.path.getmtime(self.get_executable_path())
-        except OSError:
-            exe_time = float("-inf")
+        with get_compile_lock(exe):
+            key = self.get_build_key()
+
+            if is_fresh([exe], key):
+                return
+
+            cache = self.get_cache()
+            artifacts = dict(executable=exe)
+
+            if cache.fetch(key, artifacts):
+                return
 
-        if exe_time < max(desc_time, src_time):
+            remove_stamps(artifacts.values())
             self.compile()
+            cache.store(key, artifacts)
 
     def get_execute_command(self):
         """Returns a command to execute the source.
@@ -29,6 +29,7 @@ import yaml
 from pkg_resources import resource_filename
 
 from pygon.config import BUILD_DIR, CONFIG, TEST_FORMAT
+from pygon.tracing import traced
 
 
 class Statement:
@@ -136,6 +137,7 @@ class Statement:
 
         raise ProblemConfigurationError("Resource {} not found".format(name))
 
+    @traced("statements")
     def build(self):
         """Builds the statement."""
 
@@ -23,6 +23,7 @@
 
 import os
 import shlex
+import random
 import itertools
 from enum import Enum
 
@@ -32,6 +33,7 @@ from loguru import logger
 
 from pygon.generator import Generator
 from pygon.config import TEST_FORMAT, BUILD_DIR
+from pygon.cache import Cache, make_key, is_fresh, remove_stamps
 
 class Verdict(Enum):
     """Verdict for a judgement."""
@@ -40,6 +42,7 @@ class Verdict(Enum):
     TIME_LIMIT_EXCEEDED = "TL"
     REAL_TIME_LIMIT_EXCEEDED = "RL"
     MEMORY_LIMIT_EXCEEDED = "ML"
+    OUTPUT_LIMIT_EXCEEDED = "OL"
     RUNTIME_ERROR = "RE"
     VALIDATION_FAILED = "VF"
     CHECK_FAILED = "CF"
@@ -324,6 +327,37 @@ class SolutionTest:
         return os.path.join(self.problem.root, BUILD_DIR, "outputs",
                             identifier, TEST_FORMAT.format(self.index))
 
+    def get_run_path(self, identifier):
+        """Returns a path to the result of the run (before checking).
+
+        Args:
+            identifier (str): identifier of `Solution` whose
+                              run to point to.
+        """
+
+        if self.dirname:
+            return os.path.join(self.dirname, "{}.run.yaml".format(identifier))
+
+        return os.path.join(self.problem.root, BUILD_DIR, "outputs",
+                            identifier,
+                            TEST_FORMAT.format(self.index) + ".run.yaml")
+
+    def get_trace_path(self, identifier):
+        """Returns a path to the trace of resource usage of the run
+        (see pygon.invoke.read_trace).
+
+        Args:
+            identifier (str): identifier of `Solution` whose
+                              trace to point to.
+        """
+
+        if self.dirname:
+            return os.path.join(self.dirname, "{}.trace".format(identifier))
+
+        return os.path.join(self.problem.root, BUILD_DIR, "outputs",
+                            identifier,
+                            TEST_FORMAT.format(self.index) + ".trace")
+
     def get_verdict_path(self, identifier):
         """Returns a path to the verdict.
 
@@ -348,24 +382,28 @@ class SolutionTest:
         gen = Generator.from_identifier(args.pop(0), self.problem)
         gen.ensure_compile()
 
-        if not self.dirname:
-            try:
-                gen_time = os.path.getmtime(gen.get_executable_path())
-            except OSError:
-                gen_time = os.path.getmtime(gen.get_source_path())
-
-            desc_time = os.path.getmtime(self.get_descriptor_path())
-            try:
-                res_time = os.path.getmtime(self.get_input_path())
-            except OSError:
-                res_time = float("-inf")
-
-        if self.dirname or res_time < max(gen_time, desc_time):
-            if self.index:
-                logger.info("Generating test {index}", index=self.index)
+        if self.dirname:
             dirname = os.path.dirname(self.get_input_path())
             os.makedirs(dirname, exist_ok=True)
             gen.generate(self.get_input_path(), args)
+            return
+
+        key = make_key(gen.get_build_key(), args)
+        artifacts = dict(input=self.get_input_path())
+
+        if is_fresh(artifacts.values(), key):
+            return
+
+        cache = Cache.get(self.problem.root)
+
+        if cache.fetch(key, artifacts):
+            return
+
+        logger.info("Generating test {index}", index=self.index)
+        remove_stamps(artifacts.values())
+        os.makedirs(os.path.dirname(self.get_input_path()), exist_ok=True)
+        gen.generate(self.get_input_path(), args)
+        cache.store(key, artifacts)
 
 
 def expand_range(val):
@@ -418,9 +456,92 @@ def expand_range(val):
     return range(begin, end, step)
 
 
+def parse_generator_command(cmd):
+    """Splits a generator command into tokens, expanding ranges lazily.
+
+    Args:
+        cmd (str): the source command
+
+    Returns:
+        list: a list of sequences (`range` objects for ranges and
+              one-element lists for other tokens), the expanded commands
+              are elements of their Cartesian product.
+    """
+
+    res = []
+
+    for token in shlex.split(cmd):
+        try:
+            res.append(expand_range(token))
+        except ValueError:
+            res.append([token])
+
+    return res
+
+
+def _join_generator_command(parts):
+    return " ".join(shlex.quote(str(i)) for i in parts)
+
+
+def count_generator_command(cmd):
+    """Returns the number of commands a generator command expands into
+    without expanding it."""
+
+    res = 1
+
+    for seq in parse_generator_command(cmd):
+        res *= len(seq)
+
+    return res
+
+
+def iter_generator_command(cmd):
+    """Lazily expands a generator command by expanding the ranges
+    inside it (see expand_generator_command), yielding the commands
+    one by one, so that only the current one is kept in memory.
+
+    Args:
+        cmd (str): the source command
+
+    Yields:
+        str: the expanded generator commands
+    """
+
+    for parts in itertools.product(*parse_generator_command(cmd)):
+        yield _join_generator_command(parts)
+
+
+def sample_generator_command(cmd, count, seed=None):
+    """Lazily yields a random sample of distinct commands a generator
+    command expands into, without enumerating all of them.
+
+    Args:
+        cmd (str): the source command
+        count (int): size of the sample, the whole expansion (shuffled)
+                     is yielded if it's smaller than count.
+        seed: seed for the random number generator, or None.
+
+    Yields:
+        str: the sampled generator commands
+    """
+
+    seqs = parse_generator_command(cmd)
+    total = count_generator_command(cmd)
+
+    rng = random.Random(seed)
+
+    for index in rng.sample(range(total), min(count, total)):
+        parts = []
+        for seq in reversed(seqs):
+            index, digit = divmod(index, len(seq))
+            parts.append(seq[digit])
+        yield _join_generator_command(reversed(parts))
+
+
 def expand_generator_command(cmd):
     """Expands a generator command into a list of generator commands
     by expanding the ranges inside it.
+    For huge ranges consider using iter_generator_command instead.
 
     Args:
         cmd (str): the source command
@@ -431,18 +552,8 @@ def expand_generator_command(cmd):
     >>> expand_generator_command("gen 123")
     ["gen 123"]
 
-    >>> expand_generator_command("gen [1..3] [1..2]")
-    ["gen 1 1", "gen 2 1", "gen 3 1", "gen 1 2", "gen 2 2", "gen 3 2"]
+    >>> expand_generator_command("gen [1..2] [1..3]")
+    ["gen 1 1", "gen 1 2", "gen 1 3", "gen 2 1", "gen 2 2", "gen 2 3"]
     """
 
-    spl = shlex.split(cmd)
-    res = []
-
-    for token in spl:
-        try:
-            expanded = expand_range(token)
-        except ValueError:
-            expanded = [token]
-        res.append(list(map(shlex.quote, map(str, expanded))))
-
-    return list(map(" ".join, itertools.product(*res)))
+    return list(iter_generator_command(cmd))
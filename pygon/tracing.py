@@ -0,0 +1,193 @@
+# Copyright (c) 2019 Nikita Tsarev
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""This module defines collection of per-phase timings (compilation,
+generation, validation, solution and checker runs, etc).
+
+Timings are collected only after enable() is called, otherwise spans
+cost next to nothing. Collected spans can be exported as a Chrome trace
+(viewable in chrome://tracing or https://ui.perfetto.dev) and
+summarised per phase.
+"""
+
+import os
+import json
+import time
+import functools
+import threading
+from contextlib import contextmanager
+
+try:
+    import resource
+except ImportError:
+    resource = None
+
+_events = None
+_threads = {}
+_guard = threading.Lock()
+
+
+def enable():
+    """Starts collecting timings, forgetting the collected ones."""
+
+    global _events
+
+    with _guard:
+        _events = []
+        _threads.clear()
+
+
+def is_enabled():
+    """Returns True if timings are being collected."""
+
+    return _events is not None
+
+
+def _thread_cpu():
+    # time.thread_time needs Python 3.7, fall back to the process' CPU time.
+    if hasattr(time, "thread_time"):
+        return time.thread_time()
+
+    return time.process_time()
+
+
+def _children_cpu():
+    # Not available on Windows, spans get only the thread's CPU time there.
+    if resource is None:
+        return 0.0
+
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+@contextmanager
+def span(name, phase, **args):
+    """Measures the code inside the context as a span.
+
+    CPU time of a span is the CPU time of the calling thread
+    plus the CPU time of child processes waited for meanwhile
+    (which is exact unless several jobs run simultaneously).
+    Processes run by long-lived helpers (e.g. the persistent run utility
+    or batch checkers) are not waited for, so their time isn't included.
+
+    Args:
+        name: name of the span (e.g. "solve on test 1").
+        phase: name of the phase the span belongs to (e.g. "compile").
+        args: additional data to attach to the span.
+    """
+
+    if _events is None:
+        yield
+        return
+
+    start = time.perf_counter()
+    cpu = _thread_cpu() + _children_cpu()
+
+    try:
+        yield
+    finally:
+        wall = time.perf_counter() - start
+        cpu = _thread_cpu() + _children_cpu() - cpu
+
+        with _guard:
+            if _events is not None:
+                tid = _threads.setdefault(threading.get_ident(),
+                                          len(_threads))
+                _events.append(dict(name=name, phase=phase, start=start,
+                                    wall=wall, cpu=cpu, tid=tid, args=args))
+
+
+def traced(phase):
+    """Decorator, measuring each call of a function as a span of phase,
+    named after the function (and the name of the object for methods
+    of objects having internal_name, e.g. Problems)."""
+
+    def decorator(func):
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            if _events is None:
+                return func(*args, **kwargs)
+
+            name = func.__qualname__
+            if args and hasattr(args[0], "internal_name"):
+                name += " ({})".format(args[0].internal_name)
+
+            with span(name, phase):
+                return func(*args, **kwargs)
+
+        return wrapper
+
+    return decorator
+
+
+def get_events():
+    """Returns a list of collected spans (dicts with keys name, phase,
+    start, wall, cpu, tid and args; times are in seconds)."""
+
+    with _guard:
+        return list(_events or [])
+
+
+def write_trace(path):
+    """Exports collected spans as a Chrome trace (JSON) to path."""
+
+    events = get_events()
+    origin = min([i["start"] for i in events], default=0)
+    pid = os.getpid()
+
+    trace = []
+
+    for event in events:
+        args = dict(event["args"])
+        args["cpu_ms"] = round(event["cpu"] * 1000, 3)
+        trace.append(dict(
+            name=event["name"],
+            cat=event["phase"],
+            ph="X",
+            ts=round((event["start"] - origin) * 1e6),
+            dur=round(event["wall"] * 1e6),
+            pid=pid,
+            tid=event["tid"],
+            args=args,
+        ))
+
+    with open(path, "w") as f:
+        json.dump(dict(traceEvents=trace, displayTimeUnit="ms"), f)
+
+
+def summarize():
+    """Summarises collected spans per phase.
+
+    Returns:
+        list: tuples (phase, count, wall time, CPU time), times in
+              seconds, sorted by wall time, descending. Phases include
+              the phases nested in them (e.g. "build" includes "compile").
+    """
+
+    res = {}
+
+    for event in get_events():
+        count, wall, cpu = res.get(event["phase"], (0, 0.0, 0.0))
+        res[event["phase"]] = (count + 1, wall + event["wall"],
+                               cpu + event["cpu"])
+
+    return sorted([(k,) + v for k, v in res.items()],
+                  key=lambda x: -x[2])
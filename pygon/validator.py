@@ -26,6 +26,7 @@ from collections import namedtuple
 
 from pygon.source import Source
 from pygon.testcase import Verdict
+from pygon.tracing import span
 
 
 class ValidatorVerdict(namedtuple('ValidatorVerdict', 'verdict comment')):
@@ -66,9 +67,10 @@ class Validator(Source):
 
         cmd = self.get_execute_command()
         cmd += [path]
-        with open(path, 'rb') as testf:
-            res = subprocess.run(cmd, stderr=subprocess.PIPE,
-                                 stdin=testf, universal_newlines=True)
+        with span("{} on {}".format(self.identifier, path), "validate"):
+            with open(path, 'rb') as testf:
+                res = subprocess.run(cmd, stderr=subprocess.PIPE,
+                                     stdin=testf, universal_newlines=True)
         verdict = Verdict.VALIDATION_FAILED
         if res.returncode == 0:
             verdict = Verdict.OK
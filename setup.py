@@ -94,6 +94,44 @@ class UploadCommand(Command):
         sys.exit()
 
 
+class BenchmarkCommand(Command):
+    """Support setup.py benchmark."""
+
+    description = 'Run benchmarks of testlib, checkers and run utility.'
+    user_options = [
+        ('scale=', None, 'number of values in inputs [default: 1000000]'),
+        ('runs=', None, 'number of runs of every benchmark [default: 3]'),
+        ('filter=', None, 'run only benchmarks with names containing it'),
+        ('output=', None, 'file to write results to (JSON)'),
+        ('baseline=', None, 'results to compare with (JSON)'),
+        ('threshold=', None, 'allowed slowdown [default: 0.1]'),
+    ]
+
+    def initialize_options(self):
+        self.scale = None
+        self.runs = None
+        self.filter = None
+        self.output = None
+        self.baseline = None
+        self.threshold = None
+
+    def finalize_options(self):
+        pass
+
+    def run(self):
+        sys.path.insert(0, here)
+        from benchmarks import harness
+
+        argv = []
+        for name, _, _ in self.user_options:
+            name = name.rstrip('=')
+            value = getattr(self, name)
+            if value is not None:
+                argv += ['--' + name, str(value)]
+
+        sys.exit(harness.main(argv))
+
+
 # Where the magic happens:
 setup(
     name=NAME,
@@ -126,6 +164,7 @@ setup(
     # $ setup.py publish support.
     cmdclass={
         'upload': UploadCommand,
+        'benchmark': BenchmarkCommand,
     },
     package_data={'pygon': [
         'data/checkers/*',
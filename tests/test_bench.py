@@ -0,0 +1,60 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+from pygon.bench import Samples, percentile, get_margin
+from pygon.invoke import InvokeResult
+from pygon.solution import SolutionTag
+from pygon.testcase import Verdict
+
+
+class FakeSolution:
+    def __init__(self, tag):
+        self.tag = tag
+
+
+def make_samples(*times):
+    return Samples([InvokeResult(Verdict.OK, i, 1) for i in times])
+
+
+class TestBench:
+    def test_percentile(self):
+        assert percentile([5, 1, 3, 2, 4], 50) == 3
+        assert percentile(list(range(1, 101)), 95) == 95
+        assert percentile([7], 95) == 7
+
+    def test_margin(self):
+        solutions = [
+            FakeSolution(SolutionTag("main")),
+            FakeSolution(SolutionTag("incorrect", [Verdict.TIME_LIMIT_EXCEEDED])),
+            FakeSolution(SolutionTag("incorrect", [Verdict.WRONG_ANSWER])),
+        ]
+        samples = [
+            [make_samples(0.1, 0.2, 0.25), make_samples(0.3, 0.4, 0.5)],
+            [make_samples(0.1, 0.1, 0.1), make_samples(2.0, 2.5, 3.0)],
+            [make_samples(9.0), make_samples(9.0)],
+        ]
+
+        slowest, fastest, ratio, proposal = get_margin(solutions, samples)
+
+        assert slowest == 0.5
+        assert fastest == 2.0
+        assert ratio == 4.0
+        assert proposal == 1.0
@@ -0,0 +1,113 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import shutil
+import tempfile
+
+from pygon.cache import Cache, hash_file, make_key, is_fresh
+
+
+class TestCache:
+    def test_hash_file(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "a")
+            with open(path, "w") as f:
+                f.write("hello")
+            first = hash_file(path)
+            os.utime(path, (0, 0))
+            assert hash_file(path) == first
+            with open(path, "w") as f:
+                f.write("world")
+            assert hash_file(path) != first
+
+    def test_make_key(self):
+        assert make_key("a", "b") == make_key("a", "b")
+        assert make_key("a", "b") != make_key("ab")
+        assert make_key(None) != make_key("None")
+
+    def test_store_fetch(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            cache = Cache(os.path.join(tmp, "cache"))
+            src = os.path.join(tmp, "src")
+            dst = os.path.join(tmp, "dst", "file")
+
+            with open(src, "w") as f:
+                f.write("data")
+
+            assert not cache.fetch("key", dict(file=dst))
+
+            cache.store("key", dict(file=src))
+            assert is_fresh([src], "key")
+            assert not is_fresh([src], "other")
+
+            assert cache.fetch("key", dict(file=dst))
+            assert is_fresh([dst], "key")
+            with open(dst) as f:
+                assert f.read() == "data"
+
+    def test_dedup(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            cache = Cache(os.path.join(tmp, "cache"))
+            paths = [os.path.join(tmp, i) for i in ("a", "b")]
+
+            for path in paths:
+                with open(path, "w") as f:
+                    f.write("same")
+
+            cache.store("one", dict(file=paths[0]))
+            cache.store("two", dict(file=paths[1]))
+            assert os.path.samefile(*paths)
+            assert os.path.samefile(cache.get_object_path("one", "file"),
+                                    cache.get_object_path("two", "file"))
+
+    def test_compression(self):
+        if not shutil.which("zstd"):
+            return
+
+        with tempfile.TemporaryDirectory() as tmp:
+            cache = Cache(os.path.join(tmp, "cache"), compression="zstd")
+            src = os.path.join(tmp, "src")
+            dst = os.path.join(tmp, "dst")
+
+            with open(src, "w") as f:
+                f.write("data" * 1000)
+            os.chmod(src, 0o755)
+
+            cache.store("key", dict(file=src))
+            obj = cache.find_object("key", "file")
+            assert obj.endswith(".zst")
+            assert os.path.getsize(obj) < 1000
+
+            assert cache.fetch("key", dict(file=dst))
+            with open(dst) as f:
+                assert f.read() == "data" * 1000
+            assert os.access(dst, os.X_OK)
+
+            # Equal artifacts share one uncompressed working copy.
+            assert os.path.samefile(src, dst)
+
+            other = os.path.join(tmp, "other")
+            with open(other, "w") as f:
+                f.write("data" * 1000)
+            os.chmod(other, 0o755)
+            cache.store("key2", dict(file=other))
+            assert os.path.samefile(src, other)
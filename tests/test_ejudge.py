@@ -0,0 +1,57 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import tempfile
+
+from pygon.ejudge import stage_file, remove_stale
+
+
+class TestStage:
+    def test_stage_file(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            src = os.path.join(tmp, "src")
+            dst = os.path.join(tmp, "dst")
+
+            with open(src, "w") as f:
+                f.write("data")
+
+            assert stage_file(src, dst)
+            assert not stage_file(src, dst)
+
+            # Rebuilt artifacts are new files, the staged copy is replaced.
+            os.remove(src)
+            with open(src, "w") as f:
+                f.write("other")
+            os.utime(src, (0, 0))
+
+            assert stage_file(src, dst)
+            with open(dst) as f:
+                assert f.read() == "other"
+
+    def test_remove_stale(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            for name in ("a", "b"):
+                open(os.path.join(tmp, name), "w").close()
+            os.mkdir(os.path.join(tmp, "c"))
+
+            remove_stale(tmp, {"a"})
+            assert os.listdir(tmp) == ["a"]
@@ -0,0 +1,50 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import tempfile
+
+from pygon.fileutil import clone_file, move_file
+
+
+class TestFileutil:
+    def test_clone_file_is_independent(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            src, dst = os.path.join(tmp, "src"), os.path.join(tmp, "dst")
+            with open(src, "wb") as f:
+                f.write(b"1 2\n")
+            clone_file(src, dst)
+            with open(dst, "wb") as f:
+                f.write(b"changed")
+            with open(src, "rb") as f:
+                assert f.read() == b"1 2\n"
+
+    def test_move_file_replaces(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            src, dst = os.path.join(tmp, "src"), os.path.join(tmp, "dst")
+            with open(src, "wb") as f:
+                f.write(b"3\n")
+            with open(dst, "wb") as f:
+                f.write(b"old")
+            move_file(src, dst)
+            with open(dst, "rb") as f:
+                assert f.read() == b"3\n"
+            assert not os.path.exists(src)
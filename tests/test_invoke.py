@@ -0,0 +1,81 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import sys
+import tempfile
+
+from pygon.config import CONFIG
+from pygon.invoke import TraceSample, Sandbox, Runner, summarize_trace
+
+
+def make_trace(state, read_step, rss_step):
+    return [TraceSample(i * 0.005, 0.0 if state == "S" else i * 0.005,
+                        1 + i * rss_step, state, i * read_step, 0)
+            for i in range(20)]
+
+
+class TestTrace:
+    def test_empty(self):
+        assert summarize_trace([]) is None
+
+    def test_busy(self):
+        res = summarize_trace(make_trace("R", 0, 0))
+        assert res["flags"] == []
+        assert res["cpu_share"] == 1.0
+
+    def test_io_bound(self):
+        res = summarize_trace(make_trace("S", 4096, 0))
+        assert res["flags"] == ["io-bound"]
+        assert res["read"] == 19 * 4096
+
+    def test_stalled_growing(self):
+        res = summarize_trace(make_trace("S", 0, 1))
+        assert res["flags"] == ["stalled", "memory-growing"]
+        assert res["peak_rss"] == 20
+
+
+class TestSandbox:
+    def test_reuse(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            sandbox = Sandbox(tmp)
+            path = sandbox.path
+
+            os.makedirs(os.path.join(path, "a", "b"))
+            with open(os.path.join(path, "output.txt"), "w") as f:
+                f.write("42")
+
+            sandbox.clear()
+            assert sandbox.path == path
+            assert os.listdir(path) == []
+
+            sandbox.close()
+            assert not os.path.exists(path)
+
+
+class TestRunner:
+    def test_windows(self, monkeypatch):
+        assert Runner.supports_interaction()
+
+        monkeypatch.setattr(sys, "platform", "win32")
+        monkeypatch.setitem(CONFIG, "custom_run", True)
+        assert not Runner.is_supported()
+        assert not Runner.supports_interaction()
@@ -0,0 +1,84 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import threading
+
+from pygon.scheduler import Pool, get_context
+
+
+class TestPool:
+    def test_map_serial(self):
+        with Pool(1) as pool:
+            assert pool.map(lambda x, worker: x * x, range(5)) == [0, 1, 4, 9, 16]
+
+    def test_map_parallel_keeps_order(self):
+        with Pool(4) as pool:
+            assert pool.map(lambda x, worker: x * x, range(50)) == \
+                [i * i for i in range(50)]
+
+    def test_workers_are_exclusive(self):
+        running = set()
+        overlaps = []
+        lock = threading.Lock()
+        # Every job holds its worker until two others are running too.
+        barrier = threading.Barrier(3, timeout=10)
+
+        def job(x, worker):
+            with lock:
+                if worker.index in running:
+                    overlaps.append(worker.index)
+                running.add(worker.index)
+
+            barrier.wait()
+
+            with lock:
+                assert len(running) == 3
+            barrier.wait()
+
+            with lock:
+                running.discard(worker.index)
+            return worker.index
+
+        with Pool(3) as pool:
+            assert sorted(set(pool.map(job, range(30)))) == [0, 1, 2]
+
+        assert overlaps == []
+
+    def test_callback(self):
+        seen = []
+        with Pool(2) as pool:
+            pool.map(lambda x, worker: x, range(10),
+                     callback=lambda item, res: seen.append(item))
+        assert sorted(seen) == list(range(10))
+
+    def test_context_is_inherited(self):
+        get_context()["problem"] = "a"
+
+        def job(x, worker):
+            get_context()["x"] = x
+            return get_context().get("problem")
+
+        try:
+            with Pool(2) as pool:
+                assert pool.map(job, range(4)) == ["a"] * 4
+            assert "x" not in get_context()
+        finally:
+            get_context().clear()
@@ -0,0 +1,52 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+from pygon.solution import SolutionTag
+from pygon.testcase import Verdict
+
+OK = Verdict.OK
+WA = Verdict.WRONG_ANSWER
+TL = Verdict.TIME_LIMIT_EXCEEDED
+
+
+class TestSolutionTag:
+    def test_check_all_correct(self):
+        tag = SolutionTag("correct")
+        assert tag.check_all([OK, OK])
+        assert not tag.check_all([OK, WA])
+
+    def test_check_all_incorrect(self):
+        tag = SolutionTag("incorrect", [TL])
+        assert tag.check_all([OK, TL])
+        assert not tag.check_all([OK, OK])
+        assert not tag.check_all([TL, WA])
+
+    def test_is_decided_correct(self):
+        tag = SolutionTag("correct")
+        assert not tag.is_decided([])
+        assert not tag.is_decided([OK, OK])
+        assert tag.is_decided([OK, TL])
+
+    def test_is_decided_incorrect(self):
+        tag = SolutionTag("incorrect", [TL])
+        assert not tag.is_decided([OK, OK])
+        assert tag.is_decided([OK, TL])
+        assert tag.is_decided([WA])
@@ -21,7 +21,9 @@
 
 from os.path import normpath
 
-from pygon.testcase import FileName, SolutionTest
+from pygon.testcase import FileName, SolutionTest, expand_generator_command
+from pygon.testcase import iter_generator_command, count_generator_command
+from pygon.testcase import sample_generator_command
 from pygon.problem import Problem
 
 class TestFileName:
@@ -56,3 +58,27 @@ class TestSolutionTest:
     def test_get_input_path_generated(self):
         t = SolutionTest(index=5, problem=Problem('/x/prob'), generate="gen")
         assert t.get_input_path() == normpath("/x/prob/pygon-build/tests/05")
+
+
+class TestGeneratorCommand:
+    def test_expand(self):
+        assert expand_generator_command("gen [1..2] x [3,5..7]") == [
+            "gen 1 x 3", "gen 1 x 5", "gen 1 x 7",
+            "gen 2 x 3", "gen 2 x 5", "gen 2 x 7",
+        ]
+
+    def test_count_huge(self):
+        cmd = "gen [1..1000] [1..1000] [1..100]"
+        assert count_generator_command(cmd) == 10 ** 8
+        assert next(iter_generator_command(cmd)) == "gen 1 1 1"
+
+    def test_sample(self):
+        cmd = "gen [1..1000] [1..1000] [1..100]"
+        sample = list(sample_generator_command(cmd, 100, seed=1))
+        assert len(set(sample)) == 100
+        assert sample == list(sample_generator_command(cmd, 100, seed=1))
+
+    def test_sample_whole(self):
+        cmd = "gen 'a b' [1..3]"
+        assert sorted(sample_generator_command(cmd, 10)) == \
+            expand_generator_command(cmd)
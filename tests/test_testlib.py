@@ -0,0 +1,117 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import shutil
+import subprocess
+import tempfile
+
+from pkg_resources import resource_filename
+
+
+MATCH_SRC = r"""
+#include "testlib.h"
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+    for (int i = 2; i < argc; i++)
+        printf("%d", int(pattern(argv[1]).matches(argv[i])));
+    printf("\n");
+}
+"""
+
+
+def matches(exe, ptrn, *strings):
+    res = subprocess.run([exe, ptrn] + list(strings), check=True,
+                         stdout=subprocess.PIPE).stdout.decode().strip()
+    return [c == "1" for c in res]
+
+
+class TestPattern:
+    def test_char_sets(self):
+        if shutil.which("g++") is None:
+            return
+
+        resources = resource_filename("pygon", os.path.join("data",
+                                                            "resources"))
+
+        with tempfile.TemporaryDirectory() as tmp:
+            src = os.path.join(tmp, "match.cpp")
+            exe = os.path.join(tmp, "match")
+            with open(src, "w") as f:
+                f.write(MATCH_SRC)
+            subprocess.run(["g++", "-O2", "-I", resources, src, "-o", exe],
+                           check=True)
+
+            assert matches(exe, "[a-c]{1,5}", "abc", "abd") == [True, False]
+            # Repeated chars don't make a range.
+            assert matches(exe, "[aac]", "a", "b", "c") == [True, False, True]
+            assert matches(exe, "[xxz]{1,3}", "xz", "xy") == [True, False]
+            assert matches(exe, "[aabc]{2}", "cb", "cd") == [True, False]
+
+
+# Inputs and whether wfval accepts them with LF and with CR LF line ends.
+WELL_FORMED = [
+    (b"1 2\n", True, False),
+    (b"1 2\r\n", False, True),
+    (b"a\nb\n", True, False),
+    (b"a\r\nb\r\n", False, True),
+    (b"a\nb\r\n", False, False),
+    (b"a\r", False, False),
+    (b"a", False, False),
+    (b"", False, False),
+    (b"\na\n", False, False),
+    (b"\r\na\r\n", False, False),
+    (b"a\n\n", False, False),
+    (b"a\r\n\r\n", False, False),
+    (b"a \n", False, False),
+    (b"a \r\n", False, False),
+    (b"a  b\r\n", False, False),
+    (b"a\n\nb\n", True, False),
+    (b"a\r\n\r\nb\r\n", False, True),
+]
+
+
+class TestWellFormed:
+    def test_line_ends(self):
+        if shutil.which("g++") is None:
+            return
+
+        resources = resource_filename("pygon", os.path.join("data",
+                                                            "resources"))
+        src = resource_filename("pygon", os.path.join("data", "validators",
+                                                      "wfval.cpp"))
+
+        with tempfile.TemporaryDirectory() as tmp:
+            lf = os.path.join(tmp, "wfval")
+            crlf = os.path.join(tmp, "wfval-crlf")
+            subprocess.run(["g++", "-O2", "-I", resources, src, "-o", lf],
+                           check=True)
+            subprocess.run(["g++", "-O2", "-DFOR_WINDOWS", "-I", resources,
+                            src, "-o", crlf], check=True)
+
+            for data, lf_ok, crlf_ok in WELL_FORMED:
+                for exe, ok in (lf, lf_ok), (crlf, crlf_ok):
+                    res = subprocess.run([exe], input=data,
+                                         stdout=subprocess.DEVNULL,
+                                         stderr=subprocess.DEVNULL)
+                    assert (res.returncode == 0) == ok, (exe, data)
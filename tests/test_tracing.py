@@ -0,0 +1,58 @@
+# Copyright (c) 2019 Tsarev Nikita
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+import os
+import json
+import tempfile
+
+from pygon import tracing
+
+
+class TestTracing:
+    def test_disabled_collects_nothing(self):
+        tracing._events = None
+        with tracing.span("x", "compile"):
+            pass
+        assert tracing.get_events() == []
+
+    def test_trace_and_summary(self):
+        tracing.enable()
+
+        with tracing.span("solve on test 1", "run"):
+            with tracing.span("check on test 1", "check"):
+                pass
+        with tracing.span("solve on test 2", "run"):
+            pass
+
+        summary = {i[0]: i[1] for i in tracing.summarize()}
+        assert summary == {"run": 2, "check": 1}
+
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "trace.json")
+            tracing.write_trace(path)
+            with open(path) as f:
+                events = json.load(f)["traceEvents"]
+
+        assert sorted(i["name"] for i in events) == [
+            "check on test 1", "solve on test 1", "solve on test 2"]
+        assert all(i["ph"] == "X" and "cpu_ms" in i["args"] for i in events)
+
+        tracing._events = None